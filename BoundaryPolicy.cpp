@@ -0,0 +1,31 @@
+/**************************************************************************
+**
+** Copyright (C) 2022 Ken Crossen, example expanded into useful application
+**
+** "Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are
+** met:
+**   * Redistributions of source code must retain the above copyright
+**     notice, this list of conditions and the following disclaimer.
+**   * Redistributions in binary form must reproduce the above copyright
+**     notice, this list of conditions and the following disclaimer in
+**     the documentation and/or other materials provided with the
+**     distribution.
+**   * Redistributions in source code or binary form may not be sold.
+**
+**************************************************************************/
+
+
+#include "BoundaryPolicy.h"
+
+// Constant initialized, the tables are built by the compiler
+const BoundaryPolicy::Table BoundaryPolicy::C_Like_Table = BoundaryPolicy::Make_Table<BoundaryPolicy::C_Like_Classifier>();
+const BoundaryPolicy::Table BoundaryPolicy::Prose_Table = BoundaryPolicy::Make_Table<BoundaryPolicy::Prose_Classifier>();
+const BoundaryPolicy::Table BoundaryPolicy::Numeric_Table = BoundaryPolicy::Make_Table<BoundaryPolicy::Numeric_Classifier>();
+
+const BoundaryPolicy::Table *
+BoundaryPolicy::Policy_Table ( Policy Boundary_Policy ) {
+    if (Boundary_Policy == Prose) return &Prose_Table;
+    else if (Boundary_Policy == Numeric) return &Numeric_Table;
+    return &C_Like_Table;
+}
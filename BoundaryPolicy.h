@@ -0,0 +1,122 @@
+/**************************************************************************
+**
+** Copyright (C) 2022 Ken Crossen, example expanded into useful application
+**
+** "Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are
+** met:
+**   * Redistributions of source code must retain the above copyright
+**     notice, this list of conditions and the following disclaimer.
+**   * Redistributions in binary form must reproduce the above copyright
+**     notice, this list of conditions and the following disclaimer in
+**     the documentation and/or other materials provided with the
+**     distribution.
+**   * Redistributions in source code or binary form may not be sold.
+**
+**************************************************************************/
+
+
+#ifndef BOUNDARYPOLICY_H
+#define BOUNDARYPOLICY_H
+
+#include <QChar>
+
+// Which characters continue an undo unit (identifier, word, number), ...
+// ... a unit begins w/ such a character after one that is not.
+// Each policy is a table generated at compile time, so classifying ...
+// ... a character below U+0100 is a single lookup, the rest go by ...
+// ... Unicode category as the table says.
+// An application can make its own policy from any classifier w/ ...
+// ... the same static members as those below, see Make_Table.
+class BoundaryPolicy {
+public:
+    enum Policy { C_Like, Prose, Numeric };
+
+    struct Table {
+        bool Is_Unit[256];
+        // Above U+00FF
+        bool Letters;
+        bool Numbers;
+        bool Thin_Space;
+    };
+
+    static constexpr bool Is_Latin1_Letter ( int Ch ) {
+        return (((Ch >= 'A') and (Ch <= 'Z')) or ((Ch >= 'a') and (Ch <= 'z')) or
+                (Ch == 0xaa) or (Ch == 0xb5) or (Ch == 0xba) or
+                ((Ch >= 0xc0) and (Ch <= 0xff) and (not (Ch == 0xd7)) and (not (Ch == 0xf7))));
+    }
+
+    static constexpr bool Is_Latin1_Number ( int Ch ) {
+        return (((Ch >= '0') and (Ch <= '9')) or
+                (Ch == 0xb2) or (Ch == 0xb3) or (Ch == 0xb9) or ((Ch >= 0xbc) and (Ch <= 0xbe)));
+    }
+
+    // Identifiers, keywords and numbers (w/ decimal point and thin ...
+    // ... space digit grouping), the original grouping rule
+    struct C_Like_Classifier {
+        static constexpr bool Letters = true;
+        static constexpr bool Numbers = true;
+        static constexpr bool Thin_Space = true;
+        static constexpr bool Is_Unit ( int Ch ) {
+            return (Is_Latin1_Letter(Ch) or Is_Latin1_Number(Ch) or (Ch == '_') or (Ch == '.'));
+        }
+    };
+
+    // Words, contractions and hyphenated words included
+    struct Prose_Classifier {
+        static constexpr bool Letters = true;
+        static constexpr bool Numbers = true;
+        static constexpr bool Thin_Space = false;
+        static constexpr bool Is_Unit ( int Ch ) {
+            return (Is_Latin1_Letter(Ch) or Is_Latin1_Number(Ch) or (Ch == '\'') or (Ch == '-'));
+        }
+    };
+
+    // Calculator input, only numbers (decimal, "0x"/"0b" prefixed, ...
+    // ... grouped) are units, operators and functions are not
+    struct Numeric_Classifier {
+        static constexpr bool Letters = false;
+        static constexpr bool Numbers = true;
+        static constexpr bool Thin_Space = true;
+        static constexpr bool Is_Unit ( int Ch ) {
+            return (((Ch >= '0') and (Ch <= '9')) or
+                    ((Ch >= 'a') and (Ch <= 'f')) or ((Ch >= 'A') and (Ch <= 'F')) or
+                    (Ch == 'x') or (Ch == 'X') or (Ch == '.'));
+        }
+    };
+
+    template <typename Classifier>
+    static constexpr Table Make_Table ( ) {
+        Table table = { { }, Classifier::Letters, Classifier::Numbers, Classifier::Thin_Space };
+        for (int ch = 0; ch < 256; ch += 1) table.Is_Unit[ch] = Classifier::Is_Unit(ch);
+        return table;
+    }
+
+    static const Table C_Like_Table;
+    static const Table Prose_Table;
+    static const Table Numeric_Table;
+
+    static const Table *Policy_Table ( Policy Boundary_Policy );
+
+    // A table as a type, for scans instantiated per policy: a ...
+    // ... built-in table is then a constant address, not a pointer ...
+    // ... loaded and followed for each character.
+    template <const Table &Policy_Table>
+    struct Builtin_Table {
+        const Table &Get ( ) const { return Policy_Table; }
+    };
+    struct Custom_Table {
+        const Table *Policy_Table;
+        const Table &Get ( ) const { return *Policy_Table; }
+    };
+
+    static inline bool Is_Unit ( const Table &Policy_Table, QChar Test_Ch ) {
+        ushort ch = Test_Ch.unicode();
+        if (ch < 256) return Policy_Table.Is_Unit[ch];
+        if (ch == 0x2009) return Policy_Table.Thin_Space;
+        if (Policy_Table.Letters and Test_Ch.isLetter()) return true;
+        return (Policy_Table.Numbers and Test_Ch.isNumber());
+    }
+};
+
+#endif // BOUNDARYPOLICY_H
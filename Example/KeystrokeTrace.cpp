@@ -0,0 +1,238 @@
+/**************************************************************************
+**
+** Copyright (C) 2022 Ken Crossen, example expanded into useful application
+**
+** "Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are
+** met:
+**   * Redistributions of source code must retain the above copyright
+**     notice, this list of conditions and the following disclaimer.
+**   * Redistributions in binary form must reproduce the above copyright
+**     notice, this list of conditions and the following disclaimer in
+**     the documentation and/or other materials provided with the
+**     distribution.
+**   * Redistributions in source code or binary form may not be sold.
+**
+**************************************************************************/
+
+
+#include <QTimer>
+
+#include "KeystrokeTrace.h"
+#include "PlainTextEdit.h"
+
+KeystrokeTrace::KeystrokeTrace ( QObject *parent ) : QObject(parent) {
+    Trace_Stream.setVersion(QDataStream::Qt_5_0);
+}
+
+KeystrokeTrace::~KeystrokeTrace ( ) {
+    Stop_Recording();
+}
+
+bool
+KeystrokeTrace::Start_Recording ( const QString &Trace_Path ) {
+    Stop_Recording();
+
+    Trace_File.setFileName(Trace_Path);
+    if (not Trace_File.open(QIODevice::WriteOnly | QIODevice::Truncate)) return false;
+    Trace_File.write(Keystroke_Trace_Magic, 4);
+
+    Trace_Stream.setDevice(&Trace_File);
+    Trace_Clock.start();
+    return true;
+}
+
+void
+KeystrokeTrace::Stop_Recording ( ) {
+    if (not Trace_File.isOpen()) return;
+
+    Trace_Stream.setDevice(nullptr);
+    Trace_File.close();
+}
+
+bool
+KeystrokeTrace::Is_Recording ( ) {
+    return Trace_File.isOpen();
+}
+
+void
+KeystrokeTrace::Write_Record ( const Trace_Record &Record ) {
+    Trace_Stream << quint8(Record.Type) << quint32(Trace_Clock.elapsed());
+
+    switch (Record.Type) {
+        case Trace_Key_Press:
+        case Trace_Key_Release:
+            Trace_Stream << qint32(Record.Key) << Record.Modifiers << Record.Auto_Repeat << Record.Text;
+            break;
+        case Trace_Cursor:
+            Trace_Stream << qint32(Record.Anchor) << qint32(Record.Position);
+            break;
+        case Trace_Clipboard:
+        case Trace_Insert:
+            Trace_Stream << Record.Text;
+            break;
+        case Trace_Move_Cursor:
+            Trace_Stream << qint32(Record.Position);
+            break;
+        default:
+            break;
+    }
+}
+
+void
+KeystrokeTrace::Record_Event ( Record_Type Type ) {
+    if (not Is_Recording()) return;
+
+    Trace_Record record;
+    record.Type = Type;
+    Write_Record(record);
+}
+
+void
+KeystrokeTrace::Record_Key ( Record_Type Type, QKeyEvent *Event ) {
+    if (not Is_Recording()) return;
+
+    Trace_Record record;
+    record.Type = Type;
+    record.Key = Event->key();
+    record.Modifiers = quint32(Event->modifiers());
+    record.Auto_Repeat = Event->isAutoRepeat();
+    record.Text = Event->text();
+    Write_Record(record);
+}
+
+void
+KeystrokeTrace::Record_Text ( Record_Type Type, const QString &Text ) {
+    if (not Is_Recording()) return;
+
+    Trace_Record record;
+    record.Type = Type;
+    record.Text = Text;
+    Write_Record(record);
+}
+
+void
+KeystrokeTrace::Record_Cursor ( int Anchor, int Position ) {
+    if (not Is_Recording()) return;
+
+    Trace_Record record;
+    record.Type = Trace_Cursor;
+    record.Anchor = Anchor;
+    record.Position = Position;
+    Write_Record(record);
+}
+
+void
+KeystrokeTrace::Record_Move_Cursor ( int Move_Operation ) {
+    if (not Is_Recording()) return;
+
+    Trace_Record record;
+    record.Type = Trace_Move_Cursor;
+    record.Position = Move_Operation;
+    Write_Record(record);
+}
+
+bool
+KeystrokeTrace::Load ( const QString &Trace_Path ) {
+    Records.clear();
+
+    QFile load_file(Trace_Path);
+    if (not load_file.open(QIODevice::ReadOnly)) return false;
+    if (not (load_file.read(4) == QByteArray(Keystroke_Trace_Magic))) return false;
+
+    QDataStream load_stream(&load_file);
+    load_stream.setVersion(QDataStream::Qt_5_0);
+
+    // A trace cut short (e.g. by a crash) replays up to its last ...
+    // ... complete record
+    while (not load_stream.atEnd()) {
+        Trace_Record record;
+        quint8 type;
+        qint32 key, anchor, position;
+        load_stream >> type >> record.Milliseconds;
+        record.Type = Record_Type(type);
+
+        switch (record.Type) {
+            case Trace_Key_Press:
+            case Trace_Key_Release:
+                load_stream >> key >> record.Modifiers >> record.Auto_Repeat >> record.Text;
+                record.Key = key;
+                break;
+            case Trace_Cursor:
+                load_stream >> anchor >> position;
+                record.Anchor = anchor;
+                record.Position = position;
+                break;
+            case Trace_Clipboard:
+            case Trace_Insert:
+                load_stream >> record.Text;
+                break;
+            case Trace_Move_Cursor:
+                load_stream >> position;
+                record.Position = position;
+                break;
+            default:
+                break;
+        }
+
+        if (not (load_stream.status() == QDataStream::Ok)) break;
+        Records.append(record);
+    }
+
+    return true;
+}
+
+int
+KeystrokeTrace::Record_Count ( ) {
+    return Records.count();
+}
+
+const KeystrokeTrace::Trace_Record &
+KeystrokeTrace::Record_At ( int Index ) {
+    return Records.at(Index);
+}
+
+void
+KeystrokeTrace::Replay ( PlainTextEdit *Target, bool Recorded_Pace ) {
+    Replay_Target = Target;
+    Replay_Index = 0;
+    Replay_Clock.start();
+
+    if (Recorded_Pace) {
+        Replay_Next();
+        return;
+    }
+
+    while (Replay_Index < Records.count()) {
+        Replay_Target->Replay_Trace_Record(Records.at(Replay_Index));
+        Replay_Index += 1;
+    }
+    Replay_Target = nullptr;
+    emit Replay_Finished(Replay_Clock.elapsed());
+}
+
+bool
+KeystrokeTrace::Is_Replaying ( ) {
+    return (not (Replay_Target == nullptr));
+}
+
+void
+KeystrokeTrace::Replay_Next ( ) {
+    if (Replay_Target == nullptr) return;
+
+    // Everything that is due, then wait for the next record
+    while ((Replay_Index < Records.count()) and
+           (Records.at(Replay_Index).Milliseconds <= quint64(Replay_Clock.elapsed()))) {
+        Replay_Target->Replay_Trace_Record(Records.at(Replay_Index));
+        Replay_Index += 1;
+    }
+
+    if (Replay_Index < Records.count()) {
+        qint64 wait_milliseconds = qint64(Records.at(Replay_Index).Milliseconds) - Replay_Clock.elapsed();
+        QTimer::singleShot(int(qMax(qint64(0), wait_milliseconds)), this, SLOT(Replay_Next()));
+    }
+    else {
+        Replay_Target = nullptr;
+        emit Replay_Finished(Replay_Clock.elapsed());
+    }
+}
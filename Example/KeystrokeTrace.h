@@ -0,0 +1,118 @@
+/**************************************************************************
+**
+** Copyright (C) 2022 Ken Crossen, example expanded into useful application
+**
+** "Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are
+** met:
+**   * Redistributions of source code must retain the above copyright
+**     notice, this list of conditions and the following disclaimer.
+**   * Redistributions in binary form must reproduce the above copyright
+**     notice, this list of conditions and the following disclaimer in
+**     the documentation and/or other materials provided with the
+**     distribution.
+**   * Redistributions in source code or binary form may not be sold.
+**
+**************************************************************************/
+
+
+#ifndef KEYSTROKETRACE_H
+#define KEYSTROKETRACE_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QDataStream>
+#include <QKeyEvent>
+#include <QVector>
+
+class PlainTextEdit;
+
+// Compact binary trace of what the user did to a PlainTextEdit, ...
+// ... key events, mouse selected cursor, pastes (w/ the clipboard ...
+// ... text), keypad slots, undo and redo, each w/ its time.
+// Replaying feeds the trace back through the widget's own entry ...
+// ... points, at full speed or at the recorded pace, so a captured ...
+// ... session reproduces the same work in the same order.
+// File layout: magic, then [quint8 type][quint32 milliseconds][payload].
+class KeystrokeTrace : public QObject {
+    Q_OBJECT
+public:
+    enum Record_Type : quint8 {
+        Trace_Key_Press,
+        Trace_Key_Release,
+        Trace_Cursor,
+        Trace_Clipboard,
+        Trace_Paste,
+        Trace_Context_Paste,
+        Trace_Context_Cut,
+        Trace_Context_Delete,
+        Trace_Insert,
+        Trace_Delete_Previous,
+        Trace_Move_Cursor,
+        Trace_Undo,
+        Trace_Redo,
+        Trace_Cut
+    };
+
+    struct Trace_Record {
+        Record_Type Type;
+        // Since recording started
+        quint32 Milliseconds = 0;
+        // Key events
+        int Key = 0;
+        quint32 Modifiers = 0;
+        bool Auto_Repeat = false;
+        // Key events, clipboard and inserted text
+        QString Text;
+        // Cursor (Position also carries the move operation)
+        int Anchor = 0;
+        int Position = 0;
+    };
+
+    explicit KeystrokeTrace ( QObject *parent = nullptr );
+    ~KeystrokeTrace ( );
+
+    bool Start_Recording ( const QString &Trace_Path );
+    void Stop_Recording ( );
+    bool Is_Recording ( );
+
+    void Record_Event ( Record_Type Type );
+    void Record_Key ( Record_Type Type, QKeyEvent *Event );
+    void Record_Text ( Record_Type Type, const QString &Text );
+    void Record_Cursor ( int Anchor, int Position );
+    void Record_Move_Cursor ( int Move_Operation );
+
+    bool Load ( const QString &Trace_Path );
+    int Record_Count ( );
+    const Trace_Record &Record_At ( int Index );
+
+    // At full speed the whole trace is replayed before returning, ...
+    // ... at the recorded pace it is replayed from the event loop. ...
+    // ... Either way Replay_Finished tells how long it took.
+    void Replay ( PlainTextEdit *Target, bool Recorded_Pace );
+    bool Is_Replaying ( );
+
+signals:
+    void Replay_Finished ( qint64 Elapsed_Milliseconds );
+
+private:
+#define Keystroke_Trace_Magic "KST1"
+
+    QFile Trace_File;
+    QDataStream Trace_Stream;
+    QElapsedTimer Trace_Clock;
+
+    void Write_Record ( const Trace_Record &Record );
+
+    QVector<Trace_Record> Records;
+
+    PlainTextEdit *Replay_Target = nullptr;
+    int Replay_Index = 0;
+    QElapsedTimer Replay_Clock;
+
+private slots:
+    void Replay_Next ( );
+};
+
+#endif // KEYSTROKETRACE_H
@@ -29,10 +29,16 @@ PlainTextEdit::PlainTextEdit ( QWidget *parent ) : QPlainTextEdit(parent) {
     Mouse_Release_Position = -1;
     Mouse_Released_Milliseconds = 0;
 
-    Undo_Redo = new UndoRedo(this);
-    Undo_Redo->Set_Focus_Widget(this);
-
+    // The history is created on first edit, until then the document ...
+    // ... must not keep an undo stack of its own either
+    Undo_Redo_Manager = UndoRedoManager::Shared();
+    this->setUndoRedoEnabled(false);
+
+    // contentsChange() is emitted before textChanged()
+    connect(this->document(), SIGNAL(contentsChange(int,int,int)),
+            this, SLOT(Private_contentsChange(int,int,int)));
     connect(this, SIGNAL(textChanged()), this, SLOT(Private_textChanged()));
+
     // connect(this, SIGNAL(cursorPositionChanged()), this, SLOT(Private_cursorPositionChanged()));
 }
 
@@ -51,16 +57,165 @@ PlainTextEdit::Set_Numeric_Thin_Spaces ( bool New_Numeric_Thin_Spaces ) {
     Numeric_Thin_Spaces = New_Numeric_Thin_Spaces;
 }
 
+void
+PlainTextEdit::Set_Undo_Redo_Manager ( UndoRedoManager *New_Undo_Redo_Manager ) {
+    Undo_Redo_Manager = New_Undo_Redo_Manager;
+}
+
+UndoRedo *
+PlainTextEdit::Edit_History ( ) {
+    if (Undo_Redo == nullptr) Undo_Redo = Undo_Redo_Manager->History(this);
+    return Undo_Redo;
+}
+
+bool
+PlainTextEdit::Load_File_No_Undo ( const QString &File_Path ) {
+    End_Autorepeat();
+
+    // Loaded as is, w/o regrouping digits, so the document stays ...
+    // ... exactly the text History is loaded w/
+    Suppress_PlainTextChanged = true;
+    bool file_loaded = Edit_History()->Load_File_No_Undo(File_Path);
+    Suppress_PlainTextChanged = false;
+    return file_loaded;
+}
+
+// Only what the keyboard handlers would make a plain insert or ...
+// ... delete of
+bool
+PlainTextEdit::Is_Autorepeat_Key ( QKeyEvent *event ) {
+#if defined(Q_OS_ANDROID)
+    uint modifiers = Keyboard_Modifiers;
+#else
+    Qt::KeyboardModifiers modifiers = event->modifiers();
+#endif
+    if (not (modifiers == Qt::NoModifier)) return false;
+
+    bool delete_key = ((event->key() == Qt::Key_Backspace) or (event->key() == Qt::Key_Delete));
+    bool text_key = ((event->text().length() == 1) and event->text().at(0).isPrint());
+    return (delete_key or text_key);
+}
+
+// A repeat of the key that began the run, w/o a selection to replace
+bool
+PlainTextEdit::Apply_Autorepeat ( QKeyEvent *event ) {
+    if ((not event->isAutoRepeat()) or (not (event->key() == Autorepeat_Key)) or this->isReadOnly() or
+        this->overwriteMode() or this->textCursor().hasSelection() or (not Is_Autorepeat_Key(event))) return false;
+
+    if ((event->key() == Qt::Key_Backspace) or (event->key() == Qt::Key_Delete)) {
+        QTextCursor txt_cursor = this->textCursor();
+        if (event->key() == Qt::Key_Delete) txt_cursor.deleteChar();
+        else txt_cursor.deletePreviousChar();
+        this->setTextCursor(txt_cursor);
+    }
+    else {
+        Edit_History()->Do_State += event->text();
+        QPlainTextEdit::insertPlainText(event->text());
+    }
+    return true;
+}
+
+void
+PlainTextEdit::End_Autorepeat ( ) {
+    Autorepeat_Key = 0;
+}
+
+void
+PlainTextEdit::Set_Split_Insert_Units ( bool New_Split_Insert_Units ) {
+    Split_Insert_Units = New_Split_Insert_Units;
+}
+
+void
+PlainTextEdit::Set_Keystroke_Trace ( KeystrokeTrace *New_Keystroke_Trace ) {
+    Keystroke_Trace = New_Keystroke_Trace;
+}
+
+// Only an input handler not running inside another one (or inside ...
+// ... the widget's own editing) records, Recording_Input is set ...
+// ... until its End_Trace_Input.
+bool
+PlainTextEdit::Begin_Trace_Input ( ) {
+    if (Recording_Input or (Keystroke_Trace == nullptr) or (not Keystroke_Trace->Is_Recording())) return false;
+    Recording_Input = true;
+    return true;
+}
+
+void
+PlainTextEdit::End_Trace_Input ( bool Trace_Input ) {
+    if (Trace_Input) Recording_Input = false;
+}
+
+void
+PlainTextEdit::Replay_Trace_Record ( const KeystrokeTrace::Trace_Record &Record ) {
+    // Anything but a key event ends an autorepeat run, as it did live
+    if (not ((Record.Type == KeystrokeTrace::Trace_Key_Press) or
+             (Record.Type == KeystrokeTrace::Trace_Key_Release))) End_Autorepeat();
+
+    switch (Record.Type) {
+        case KeystrokeTrace::Trace_Key_Press:
+        case KeystrokeTrace::Trace_Key_Release: {
+            QKeyEvent key_event((Record.Type == KeystrokeTrace::Trace_Key_Press) ? QEvent::KeyPress : QEvent::KeyRelease,
+                                Record.Key, Qt::KeyboardModifiers(Record.Modifiers), Record.Text, Record.Auto_Repeat);
+            QApplication::sendEvent(this, &key_event);
+            break;
+        }
+        case KeystrokeTrace::Trace_Cursor: {
+            // Same as a mouse press/release would leave it
+            Edit_History()->Deferred_Push_Undo = true;
+            QTextCursor txt_cursor = this->textCursor();
+            txt_cursor.setPosition(Record.Anchor, QTextCursor::MoveAnchor);
+            txt_cursor.setPosition(Record.Position, QTextCursor::KeepAnchor);
+            this->setTextCursor(txt_cursor);
+            break;
+        }
+        case KeystrokeTrace::Trace_Clipboard:
+            QApplication::clipboard()->setText(Record.Text);
+            break;
+        case KeystrokeTrace::Trace_Paste:
+            this->paste();
+            break;
+        case KeystrokeTrace::Trace_Context_Paste:
+            this->onContextPaste();
+            break;
+        case KeystrokeTrace::Trace_Context_Cut:
+            this->onContextCutSelection();
+            break;
+        case KeystrokeTrace::Trace_Context_Delete:
+            this->onContextDeleteSelection();
+            break;
+        case KeystrokeTrace::Trace_Insert:
+            this->insertPlainText(Record.Text);
+            break;
+        case KeystrokeTrace::Trace_Delete_Previous:
+            this->Delete_Previous_Character();
+            break;
+        case KeystrokeTrace::Trace_Move_Cursor:
+            this->Move_Cursor(QTextCursor::MoveOperation(Record.Position));
+            break;
+        case KeystrokeTrace::Trace_Undo:
+            this->undo();
+            break;
+        case KeystrokeTrace::Trace_Redo:
+            this->redo();
+            break;
+        case KeystrokeTrace::Trace_Cut:
+            this->cut();
+            break;
+    }
+}
+
 #define QChar_TextCursorIndicator QChar(0x25b2)
 
+// The indicator is not in the text, there is nothing to remove
 QString
 PlainTextEdit::toPlainText_Clean ( ) {
-    return QPlainTextEdit::toPlainText().remove(QChar_TextCursorIndicator);
+    return QPlainTextEdit::toPlainText();
 }
 
+// Removed in place, the text is not shared yet
 QString
 PlainTextEdit::toPlainText_Clean_No_ThinSpace ( ) {
-    return QPlainTextEdit::toPlainText().remove(QChar_TextCursorIndicator).remove(Unicode_Thin_Space);
+    return QPlainTextEdit::toPlainText().remove(Unicode_Thin_Space);
 }
 
 //void
@@ -71,18 +226,30 @@ PlainTextEdit::toPlainText_Clean_No_ThinSpace ( ) {
 // Must ambush/subvert these ...
 void
 PlainTextEdit::undo ( ) {
+    End_Autorepeat();
+    bool trace_input = Begin_Trace_Input();
+    if (trace_input) Keystroke_Trace->Record_Event(KeystrokeTrace::Trace_Undo);
+
     // QPlainTextEdit::undo();
     Suppress_PlainTextChanged = true;
-    Undo_Redo->Execute_Undo();
+    if (not (Undo_Redo == nullptr)) Undo_Redo->Execute_Undo();
     Suppress_PlainTextChanged = false;
+
+    End_Trace_Input(trace_input);
 }
 
 void
 PlainTextEdit::redo ( ) {
+    End_Autorepeat();
+    bool trace_input = Begin_Trace_Input();
+    if (trace_input) Keystroke_Trace->Record_Event(KeystrokeTrace::Trace_Redo);
+
     // QPlainTextEdit::redo();
     Suppress_PlainTextChanged = true;
-    Undo_Redo->Execute_Redo();
+    if (not (Undo_Redo == nullptr)) Undo_Redo->Execute_Redo();
     Suppress_PlainTextChanged = false;
+
+    End_Trace_Input(trace_input);
 }
 
 void
@@ -92,54 +259,110 @@ PlainTextEdit::copy ( ) {
 
 void
 PlainTextEdit::cut ( ) {
-    Undo_Redo->Push_Undo();
+    End_Autorepeat();
+    bool trace_input = Begin_Trace_Input();
+    if (trace_input) Keystroke_Trace->Record_Event(KeystrokeTrace::Trace_Cut);
+
+    Edit_History()->Push_Undo();
     QPlainTextEdit::cut();
+
+    End_Trace_Input(trace_input);
 }
 
 void
 PlainTextEdit::paste ( ) {
-    Undo_Redo->Push_Undo();
+    End_Autorepeat();
+    bool trace_input = Begin_Trace_Input();
+    if (trace_input) {
+        Keystroke_Trace->Record_Text(KeystrokeTrace::Trace_Clipboard, QApplication::clipboard()->text());
+        Keystroke_Trace->Record_Event(KeystrokeTrace::Trace_Paste);
+    }
+
+    Edit_History()->Push_Undo();
     QPlainTextEdit::paste();
+    if (Split_Insert_Units) Edit_History()->Push_Undo_Units();
+
+    End_Trace_Input(trace_input);
 }
 // ... Must ambush/subvert these
 
 void
 PlainTextEdit::insertPlainText(const QString &Text) {
-    Undo_Redo->Redo_Stack_Clear();
+    End_Autorepeat();
+    bool trace_input = Begin_Trace_Input();
+    if (trace_input) Keystroke_Trace->Record_Text(KeystrokeTrace::Trace_Insert, Text);
+
+    UndoRedo *undo_redo = Edit_History();
+    undo_redo->Redo_Stack_Clear();
+
+    // Inserted once, then recorded as though typed unit by unit ...
+    // ... (not digit regrouping, that is part of the insert it follows)
+    if (Split_Insert_Units and (Text.length() > 1) and (not Suppress_PlainTextChanged)) {
+        undo_redo->Push_Undo();
+        QPlainTextEdit::insertPlainText(Text);
+        undo_redo->Push_Undo_Units();
+
+        End_Trace_Input(trace_input);
+        return;
+    }
 
-    if (Undo_Redo->Deferred_Push_Undo or (Undo_Redo->Undo_Stack_Count() == 0)) {
-        Undo_Redo->Push_Undo();
+    if (undo_redo->Deferred_Push_Undo or (undo_redo->Undo_Stack_Count() == 0)) {
+        undo_redo->Push_Undo();
     }
-    else if (Undo_Redo->Do_State.length() > 0) {
+    else if (undo_redo->Do_State.length() > 0) {
         if (Text.length() > 1) {
-            Undo_Redo->Push_Undo();
+            undo_redo->Push_Undo();
         }
         else {
-            if ((not Undo_Redo->Is_Identifier_Or_Number(Undo_Redo->Do_State.at(Undo_Redo->Do_State.length() - 1))) and
-                Undo_Redo->Is_Identifier_Or_Number(Text.at(0))) {
-                Undo_Redo->Push_Undo();
+            if ((not undo_redo->Is_Identifier_Or_Number(undo_redo->Do_State.at(undo_redo->Do_State.length() - 1))) and
+                undo_redo->Is_Identifier_Or_Number(Text.at(0))) {
+                undo_redo->Push_Undo();
             }
         }
     }
 
     QPlainTextEdit::insertPlainText(Text);
-    Undo_Redo->Do_State += Text;
+    undo_redo->Do_State += Text;
+
+    End_Trace_Input(trace_input);
 }
 
 void
 PlainTextEdit::Delete_Previous_Character ( ) {
-    Undo_Redo->Push_Undo();
+    End_Autorepeat();
+    bool trace_input = Begin_Trace_Input();
+    if (trace_input) Keystroke_Trace->Record_Event(KeystrokeTrace::Trace_Delete_Previous);
+
+    Edit_History()->Push_Undo();
 
     QTextCursor txt_cursor = this->textCursor();
     txt_cursor.deletePreviousChar();
     this->setTextCursor(txt_cursor);
+
+    End_Trace_Input(trace_input);
 }
 
 void
 PlainTextEdit::keyPressEvent ( QKeyEvent *event ) {
+    bool trace_input = Begin_Trace_Input();
+    if (trace_input) {
+        // Replay must paste what was pasted, not what is on the clipboard then
+        if (event->matches(QKeySequence::Paste))
+            Keystroke_Trace->Record_Text(KeystrokeTrace::Trace_Clipboard, QApplication::clipboard()->text());
+        Keystroke_Trace->Record_Key(KeystrokeTrace::Trace_Key_Press, event);
+    }
+
     emit keyPressed(event->key());
 
-    bool event_already_handled = Undo_Redo->keyPressEvent_Handler(event);
+    // W/o a boundary decision, see Apply_Autorepeat
+    if (Apply_Autorepeat(event)) {
+        event->accept();
+        End_Trace_Input(trace_input);
+        return;
+    }
+    End_Autorepeat();
+
+    bool event_already_handled = Edit_History()->keyPressEvent_Handler(event);
     if (event_already_handled) {
         // Do not allow normal event handling
         event->accept();
@@ -147,11 +370,26 @@ PlainTextEdit::keyPressEvent ( QKeyEvent *event ) {
     else {
         // Normal event handling
         QPlainTextEdit::keyPressEvent(event);
+
+        // Keyboard paste, the boundary before it was already pushed
+        if (Split_Insert_Units and (not this->isReadOnly()) and event->matches(QKeySequence::Paste))
+            Edit_History()->Push_Undo_Units();
     }
+
+    // The press that may begin an autorepeat run
+    if (Is_Autorepeat_Key(event)) Autorepeat_Key = event->key();
+
+    End_Trace_Input(trace_input);
 }
 
 void
 PlainTextEdit::keyReleaseEvent ( QKeyEvent *event ) {
+    bool trace_input = Begin_Trace_Input();
+    if (trace_input) Keystroke_Trace->Record_Key(KeystrokeTrace::Trace_Key_Release, event);
+
+    // Some platforms release between autorepeated presses
+    if (not event->isAutoRepeat()) End_Autorepeat();
+
     // Can't use Undo_Redo->keyReleaseEvent_Handler ...
     // ... need to wrap w/ suppression of text change
     if (event->matches(QKeySequence::Undo)) {
@@ -169,173 +407,180 @@ PlainTextEdit::keyReleaseEvent ( QKeyEvent *event ) {
     else {
         QPlainTextEdit::keyReleaseEvent(event);
     }
+
+    End_Trace_Input(trace_input);
 }
 
 void
 PlainTextEdit::Move_Cursor ( QTextCursor::MoveOperation Move_Operation ) {
+    End_Autorepeat();
+    bool trace_input = Begin_Trace_Input();
+    if (trace_input) Keystroke_Trace->Record_Move_Cursor(int(Move_Operation));
+
     // The goal here is to avoid a series of cursor movment ...
     // ... pushes to the undo stack.
-    Undo_Redo->Deferred_Push_Undo = true;
+    Edit_History()->Deferred_Push_Undo = true;
 
     QTextCursor txt_cursor = this->textCursor();
     txt_cursor.movePosition(Move_Operation);
     this->setTextCursor(txt_cursor);
+
+    End_Trace_Input(trace_input);
 }
 
 // Dynamically manages digit grouping ...
+static bool
+Is_Number_Digit ( QChar Test_Ch, int Radix ) {
+    ushort ch = Test_Ch.unicode();
+    if (Radix == 2) return ((ch == '0') or (ch == '1'));
+    if (Radix == 16) return (((ch >= '0') and (ch <= '9')) or
+                             ((ch >= 'a') and (ch <= 'f')) or
+                             ((ch >= 'A') and (ch <= 'F')));
+    return ((ch >= '0') and (ch <= '9'));
+}
+
+static bool
+Is_Identifier_Character ( QChar Test_Ch ) {
+    return (Test_Ch.isLetterOrNumber() or (Test_Ch == '_'));
+}
+
+// Widens [Begin, End) from Position over digits of Radix, thin spaces ...
+// ... and at most one decimal point, a single pass each way.
+static void
+Scan_Number_Digits ( const QString &Line, int Position, int Radix, int &Begin, int &End ) {
+    bool has_point = false;
+
+    Begin = Position;
+    while (Begin > 0) {
+        QChar test_ch = Line.at(Begin - 1);
+        if (Is_Number_Digit(test_ch, Radix) or (test_ch == Unicode_Thin_Space)) Begin -= 1;
+        else if ((test_ch == '.') and (not has_point)) {
+            has_point = true;
+            Begin -= 1;
+        }
+        else break;
+    }
+
+    End = Position;
+    while (End < Line.length()) {
+        QChar test_ch = Line.at(End);
+        if (Is_Number_Digit(test_ch, Radix) or (test_ch == Unicode_Thin_Space)) End += 1;
+        else if ((test_ch == '.') and (not has_point)) {
+            has_point = true;
+            End += 1;
+        }
+        else break;
+    }
+
+    // Number must start with a digit
+    while ((Begin < End) and (not Is_Number_Digit(Line.at(Begin), Radix))) Begin += 1;
+}
+
+// Locates the (syntactically isolated) number around Position: ...
+// ... decimal, or hexadecimal/binary w/ a "0x"/"0b" prefix.
+// Begin includes the prefix, Prefix_Length tells how long it is.
+static bool
+Find_Number ( const QString &Line, int Position, int &Begin, int &End, int &Radix, int &Prefix_Length ) {
+    static const int radixes[] = { 10, 2, 16 };
+
+    for (int radix : radixes) {
+        Scan_Number_Digits(Line, Position, radix, Begin, End);
+        if (Begin == End) continue;
+
+        Prefix_Length = 0;
+        if (not (radix == 10)) {
+            QChar prefix_ch = (radix == 2) ? 'b' : 'x';
+            if ((Begin < 2) or
+                (not (Line.at(Begin - 2) == '0')) or
+                (not (Line.at(Begin - 1).toLower() == prefix_ch))) continue;
+            Prefix_Length = 2;
+            Begin -= 2;
+        }
+
+        if (((Begin == 0) or (not Is_Identifier_Character(Line.at(Begin - 1)))) and
+            ((End == Line.length()) or (not Is_Identifier_Character(Line.at(End))))) {
+            Radix = radix;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// Number w/o thin spaces, grouped away from the decimal point
+static QString
+Group_Number_Digits ( const QString &Number, int Prefix_Length, int Group_Size ) {
+    int point_position = Number.indexOf('.');
+    if (point_position < 0) point_position = Number.length();
+
+    QString grouped_number = Number.left(Prefix_Length);
+    grouped_number.reserve(Number.length() + (Number.length() / Group_Size) + 1);
+
+    // Insert integer part digit grouping separator
+    for (int ch_idx = Prefix_Length; ch_idx < point_position; ch_idx += 1) {
+        if ((ch_idx > Prefix_Length) and (((point_position - ch_idx) % Group_Size) == 0))
+            grouped_number += Unicode_Thin_Space;
+        grouped_number += Number.at(ch_idx);
+    }
+
+    // Insert fractional part digit grouping separator
+    for (int ch_idx = point_position; ch_idx < Number.length(); ch_idx += 1) {
+        if ((ch_idx > (point_position + 1)) and (((ch_idx - point_position - 1) % Group_Size) == 0))
+            grouped_number += Unicode_Thin_Space;
+        grouped_number += Number.at(ch_idx);
+    }
+
+    return grouped_number;
+}
+
+void
+PlainTextEdit::Private_contentsChange ( int Position, int Chars_Removed, int Chars_Added ) {
+    Q_UNUSED(Chars_Removed);
+    Changed_Position = Position + Chars_Added;
+
+    // As when it was a character the next keystroke replaced, ...
+    // ... the indicator goes w/ any edit
+    removeTextCursorIndicator();
+}
+
 void
 PlainTextEdit::Private_textChanged ( ) {
     if (Suppress_PlainTextChanged) return;
+    // Slices of an asynchronous restore are not edits, nothing is ...
+    // ... regrouped (or pushed) until the restore has finished
+    if ((not (Undo_Redo == nullptr)) and Undo_Redo->Is_Restoring()) return;
 
     if (Numeric_Thin_Spaces) {
         Suppress_PlainTextChanged = true;
 
-        // What about hexadecimal & binary numbers?
-        QString plain_txt = this->toPlainText();
+        // Numbers never span lines, only the changed block is scanned
         QTextCursor txt_cursor = this->textCursor();
-        int cursor_position = txt_cursor.position();
-
-        // Number must start with a digit
-        QRegExp decimal_number_rx = QRegExp("[0-9\\x2009]+[.]?[0-9\\x2009]*");
-
-        // Locate integer part
-        int begin_number_position = cursor_position;
-        int end_number_position = cursor_position;
-        QString test_number = "";
-        QString test_txt;
-        while (begin_number_position > 0) {
-            test_txt = plain_txt.at(begin_number_position - 1) + test_number;
-            if ((test_txt == ".") or
-                decimal_number_rx.exactMatch(test_txt)) {
-                test_number = test_txt;
-                begin_number_position -= 1;
-            }
-            else break;
-        }
-
-        // Locate fractional part, if any
-        while (end_number_position < plain_txt.length()) {
-            test_txt.append(plain_txt.at(end_number_position));
-            if (decimal_number_rx.exactMatch(test_txt)) {
-                test_number = test_txt;
-                end_number_position += 1;
-            }
-            else break;
-        }
-
-        if (((begin_number_position == 0) or
-             (not (plain_txt.at(begin_number_position - 1).isLetterOrNumber() or
-                  (plain_txt.at(begin_number_position - 1) == "_")))) and
-            ((end_number_position == plain_txt.length()) or
-             (not (plain_txt.at(end_number_position + 1).isLetterOrNumber() or
-                  (plain_txt.at(end_number_position + 1) == "_"))))) {
-            // Syntactically "isolated" now
-            QString number = test_number.remove(Unicode_Thin_Space);
-            if (decimal_number_rx.exactMatch(number)) {
-                // Insert integer part digit grouping separator
-                int decimal_point_position = number.indexOf(".");
-                if (decimal_point_position < 0) decimal_point_position = number.length();
-                int ch_idx = decimal_point_position - 1;
-                while (ch_idx >= 3) {
-                    ch_idx = ch_idx - 2;
-                    number.insert(ch_idx, Unicode_Thin_Space);
-                    ch_idx = ch_idx - 1;
-                }
-                // Insert fractional part digit grouping separator
-                decimal_point_position = number.indexOf(".");
-                if (decimal_point_position < 0) decimal_point_position = number.length();
-                ch_idx = decimal_point_position + 1;
-                while (ch_idx <= (number.length() - 3)) {
-                    ch_idx = ch_idx + 3;
-                    number.insert(ch_idx, Unicode_Thin_Space);
-                    // Pass the thin space
-                    ch_idx = ch_idx + 1;
-                }
-
-                txt_cursor.setPosition(begin_number_position, QTextCursor::MoveAnchor);
-                txt_cursor.setPosition(end_number_position, QTextCursor::KeepAnchor);
+        QTextBlock txt_block = this->document()->findBlock(Changed_Position);
+        QString block_txt = txt_block.text();
+
+        int begin_number_position, end_number_position, radix, prefix_length;
+        if (txt_block.isValid() and
+            Find_Number(block_txt, qMin(Changed_Position - txt_block.position(), block_txt.length()),
+                        begin_number_position, end_number_position, radix, prefix_length)) {
+            QString current_number = block_txt.mid(begin_number_position, end_number_position - begin_number_position);
+            QString number = current_number;
+            number.remove(Unicode_Thin_Space);
+            number = Group_Number_Digits(number, prefix_length, (radix == 10) ? 3 : 4);
+
+            // Leave the document (and the undo history) alone if the ...
+            // ... grouping is already right
+            if (not (number == current_number)) {
+                txt_cursor.setPosition(txt_block.position() + begin_number_position, QTextCursor::MoveAnchor);
+                txt_cursor.setPosition(txt_block.position() + end_number_position, QTextCursor::KeepAnchor);
                 txt_cursor.removeSelectedText();
-                txt_cursor.setPosition(begin_number_position, QTextCursor::MoveAnchor);
+                txt_cursor.setPosition(txt_block.position() + begin_number_position, QTextCursor::MoveAnchor);
                 this->setTextCursor(txt_cursor);
+                // The widget's own edit, whatever triggered it (a drop, ...
+                // ... IME, an autorepeated key) is not an input to record
+                bool recording_input = Recording_Input;
+                Recording_Input = true;
                 this->insertPlainText(number);
-            }
-        }
-        else {
-            // Number must start with "0x or "0b", ...
-            // ... but cut some slack searching for start of number
-            QRegExp find_hexadecimal_number_rx = QRegExp("x?[0-9A-F\\x2009]+[.]?[0-9A-F\\x2009]*", Qt::CaseInsensitive);
-            QRegExp find_binary_number_rx = QRegExp("b?[01\\x2009]+[.]?[01\\x2009]*", Qt::CaseInsensitive);
-
-            QRegExp hexadecimal_number_rx = QRegExp("0x[0-9A-F\\x2009]+[.]?[0-9A-F\\x2009]*", Qt::CaseInsensitive);
-            QRegExp binary_number_rx = QRegExp("0b[01\\x2009]+[.]?[01\\x2009]*", Qt::CaseInsensitive);
-
-            // Locate integer part
-            int begin_number_position = cursor_position;
-            int end_number_position = cursor_position;
-            QString test_number = "";
-            QString test_txt;
-            while (begin_number_position > 0) {
-                test_txt = plain_txt.at(begin_number_position - 1) + test_number;
-                if ((test_txt == ".") or
-                    find_hexadecimal_number_rx.exactMatch(test_txt) or
-                    hexadecimal_number_rx.exactMatch(test_txt) or
-                    find_binary_number_rx.exactMatch(test_txt) or
-                    binary_number_rx.exactMatch(test_txt)) {
-                    test_number = test_txt;
-                    begin_number_position -= 1;
-                }
-                else break;
-            }
-
-            // Locate fractional part, if any
-            while (end_number_position < plain_txt.length()) {
-                test_txt = test_number + plain_txt.at(end_number_position);
-                if (hexadecimal_number_rx.exactMatch(test_txt) or
-                    binary_number_rx.exactMatch(test_txt)) {
-                    test_number = test_txt;
-                    end_number_position += 1;
-                }
-                else break;
-            }
-
-            if (((begin_number_position == 0) or
-                 (not (plain_txt.at(begin_number_position - 1).isLetterOrNumber() or
-                      (plain_txt.at(begin_number_position - 1) == "_")))) and
-                ((end_number_position == plain_txt.length()) or
-                 (not (plain_txt.at(end_number_position + 1).isLetterOrNumber() or
-                      (plain_txt.at(end_number_position + 1) == "_"))))) {
-                // Syntactically "isolated" now
-                QString number = test_number.remove(Unicode_Thin_Space);
-                if ((hexadecimal_number_rx.exactMatch(number)) or
-                    (binary_number_rx.exactMatch(number))) {
-                    // Insert integer part digit grouping separator
-                    int decimal_point_position = number.indexOf(".");
-                    if (decimal_point_position < 0) decimal_point_position = number.length();
-                    int ch_idx = decimal_point_position - 1;
-                    // Take "0b" or "0x" into account
-                    while (ch_idx >= (2 /* "0b" or "0x" */ + 4)) {
-                        ch_idx = ch_idx - 3;
-                        number.insert(ch_idx, Unicode_Thin_Space);
-                        ch_idx = ch_idx - 1;
-                    }
-                    // Insert fractional part digit grouping separator
-                    decimal_point_position = number.indexOf(".");
-                    if (decimal_point_position < 0) decimal_point_position = number.length();
-                    ch_idx = decimal_point_position + 1;
-                    while (ch_idx <= (number.length() - 4)) {
-                        ch_idx = ch_idx + 4;
-                        number.insert(ch_idx, Unicode_Thin_Space);
-                        // Pass the thin space
-                        ch_idx = ch_idx + 1;
-                    }
-
-                    txt_cursor.setPosition(begin_number_position, QTextCursor::MoveAnchor);
-                    txt_cursor.setPosition(end_number_position, QTextCursor::KeepAnchor);
-                    txt_cursor.removeSelectedText();
-                    txt_cursor.setPosition(begin_number_position, QTextCursor::MoveAnchor);
-                    this->setTextCursor(txt_cursor);
-                    this->insertPlainText(number);
-                }
+                Recording_Input = recording_input;
             }
         }
 
@@ -359,6 +604,7 @@ PlainTextEdit::focusInEvent ( QFocusEvent *event ) {
 
 void
 PlainTextEdit::focusOutEvent ( QFocusEvent *event ) {
+    End_Autorepeat();
     if (event->reason() == Qt::MouseFocusReason) emit focusOut();
     QPlainTextEdit::focusOutEvent(event);
     // if (not Has_Focus) {
@@ -373,29 +619,51 @@ PlainTextEdit::TextCursorIndicator ( ) {
     return QChar_TextCursorIndicator;
 }
 
+bool
+PlainTextEdit::Has_TextCursorIndicator ( ) {
+    return TextCursorIndicator_Shown;
+}
+
 void
 PlainTextEdit::insertTextCursorIndicator ( ) {
-    Suppress_PlainTextChanged = true;
-    if (QPlainTextEdit::toPlainText().length() > 0) {
-        QPlainTextEdit::insertPlainText(QChar_TextCursorIndicator);
-        QPlainTextEdit::moveCursor(QTextCursor::Left, QTextCursor::KeepAnchor);
-    }
-    Suppress_PlainTextChanged = false;
+    if (document()->isEmpty()) return;
+    TextCursorIndicator_Cursor = QPlainTextEdit::textCursor();
+    TextCursorIndicator_Cursor.clearSelection();
+    TextCursorIndicator_Shown = true;
+    viewport()->update();
 }
 
 void
 PlainTextEdit::removeTextCursorIndicator ( ) {
-    Suppress_PlainTextChanged = true;
-    QTextCursor txtcur = QPlainTextEdit::textCursor();
-    QPlainTextEdit::moveCursor(QTextCursor::End);
-    if (QPlainTextEdit::find(QChar_TextCursorIndicator, QTextDocument::FindBackward))
-        QPlainTextEdit::insertPlainText("");
-    else QPlainTextEdit::setTextCursor(txtcur);
-    Suppress_PlainTextChanged = false;
+    if (not TextCursorIndicator_Shown) return;
+    TextCursorIndicator_Shown = false;
+    viewport()->update();
+}
+
+void
+PlainTextEdit::paintEvent ( QPaintEvent *event ) {
+    QPlainTextEdit::paintEvent(event);
+    if (not TextCursorIndicator_Shown) return;
+
+    // Centered on the cursor position, sitting on its line's baseline
+    QRect cursor_rect = cursorRect(TextCursorIndicator_Cursor);
+    QString indicator_text = QString(QChar_TextCursorIndicator);
+    QFontMetrics font_metrics = fontMetrics();
+#if QT_VERSION >= QT_VERSION_CHECK(5, 11, 0)
+    int indicator_width = font_metrics.horizontalAdvance(indicator_text);
+#else
+    int indicator_width = font_metrics.width(indicator_text);
+#endif
+
+    QPainter painter(viewport());
+    painter.setPen(palette().color(QPalette::Highlight));
+    painter.drawText(cursor_rect.left() - (indicator_width / 2),
+                     cursor_rect.bottom() - font_metrics.descent(), indicator_text);
 }
 
 void
 PlainTextEdit::mousePressEvent ( QMouseEvent* event ) {
+    End_Autorepeat();
     Mouse_Pressed_Milliseconds = QDateTime::currentMSecsSinceEpoch();
     Mouse_Press_Cursor_Position = event->pos();
 
@@ -410,7 +678,8 @@ PlainTextEdit::mousePressEvent ( QMouseEvent* event ) {
 
     // The goal here is to avoid a series of cursor movment ...
     // ... pushes to the undo stack.
-    Undo_Redo->Deferred_Push_Undo = true;
+    // W/o a history yet the first edit pushes anyway.
+    if (not (Undo_Redo == nullptr)) Undo_Redo->Deferred_Push_Undo = true;
 
     // Allow super class (normal) handling of event
     QPlainTextEdit::mousePressEvent(event);
@@ -450,6 +719,8 @@ PlainTextEdit::mouseMoveEvent ( QMouseEvent* event ) {
 
 void
 PlainTextEdit::mouseReleaseEvent ( QMouseEvent* event ) {
+    bool trace_input = Begin_Trace_Input();
+
     if (not Support_Long_Press) {
         // Allow super class (normal) handling of event
         QPlainTextEdit::mouseReleaseEvent(event);
@@ -497,6 +768,11 @@ PlainTextEdit::mouseReleaseEvent ( QMouseEvent* event ) {
             emit changedFocus(Has_Focus);
         }
     }
+
+    // Where the press/drag/release left the cursor, not the pixels
+    if (trace_input)
+        Keystroke_Trace->Record_Cursor(this->textCursor().anchor(), this->textCursor().position());
+    End_Trace_Input(trace_input);
 }
 
 void
@@ -541,18 +817,26 @@ PlainTextEdit::onContextCopySelection ( ) {
 
 void
 PlainTextEdit::onContextCutSelection ( ) {
+    End_Autorepeat();
     QTextCursor txt_cursor = this->textCursor();
     QClipboard *clipboard = QApplication::clipboard();
     clipboard->setText(txt_cursor.selectedText());
 
-    Undo_Redo->Push_Undo();
+    bool trace_input = Begin_Trace_Input();
+    if (trace_input) Keystroke_Trace->Record_Event(KeystrokeTrace::Trace_Context_Cut);
+    Edit_History()->Push_Undo();
     txt_cursor.removeSelectedText();
+    End_Trace_Input(trace_input);
 }
 
 void
 PlainTextEdit::onContextDeleteSelection ( ) {
-    Undo_Redo->Push_Undo();
+    End_Autorepeat();
+    bool trace_input = Begin_Trace_Input();
+    if (trace_input) Keystroke_Trace->Record_Event(KeystrokeTrace::Trace_Context_Delete);
+    Edit_History()->Push_Undo();
     this->textCursor().removeSelectedText();
+    End_Trace_Input(trace_input);
 }
 
 void
@@ -585,6 +869,12 @@ void
 PlainTextEdit::onContextPaste ( ) {
     QClipboard *clipboard = QApplication::clipboard();
     QString clipboard_text = clipboard->text(QClipboard::Clipboard);
+
+    bool trace_input = Begin_Trace_Input();
+    if (trace_input) {
+        Keystroke_Trace->Record_Text(KeystrokeTrace::Trace_Clipboard, clipboard_text);
+        Keystroke_Trace->Record_Event(KeystrokeTrace::Trace_Context_Paste);
+    }
     // If clipboard text has the form "12345.6789 { blah, blah, blah }" ...
     // ... paste "{ blah, blah, blah }" into Algebraic_PlainTextEdit
     // ... else paste clipboard text into Algebraic_PlainTextEdit
@@ -597,4 +887,5 @@ PlainTextEdit::onContextPaste ( ) {
     else {
         this->insertPlainText(clipboard_text);
     }
+    End_Trace_Input(trace_input);
 }
@@ -24,11 +24,16 @@
 #include <QMenu>
 #include <QDateTime>
 #include <QKeyEvent>
+#include <QPainter>
+#include <QPaintEvent>
 #include <QScrollBar>
 #include <QStack>
+#include <QTextBlock>
 
 #include "UI_Defines.h"
 #include "UndoRedo.h"
+#include "UndoRedoManager.h"
+#include "KeystrokeTrace.h"
 
 class PlainTextEdit : public QPlainTextEdit {
     Q_OBJECT
@@ -38,7 +43,10 @@ public:
     QString toPlainText_Clean ( );
     QString toPlainText_Clean_No_ThinSpace ( );
 
+    // The indicator is painted over the text, never part of it, ...
+    // ... so showing or hiding it leaves the document alone.
     QChar TextCursorIndicator ( );
+    bool Has_TextCursorIndicator ( );
 
     void
     insertTextCursorIndicator ( );
@@ -48,17 +56,49 @@ public:
     void
     Set_Numeric_Thin_Spaces ( bool New_Numeric_Thin_Spaces );
 
+    // See UndoRedo::Load_File_No_Undo
+    bool
+    Load_File_No_Undo ( const QString &File_Path );
+
+    // The shared manager by default, must be set before the first edit
+    void
+    Set_Undo_Redo_Manager ( UndoRedoManager *New_Undo_Redo_Manager );
+
+    // Multi-character inserts and pastes are undone word by word ...
+    // ... (identifier/number units) rather than all at once.
+    void
+    Set_Split_Insert_Units ( bool New_Split_Insert_Units );
+
     void
     Set_Support_Long_Press ( bool New_Support_Long_Press );
 
     void
     Set_Long_Press_Milliseconds_Threshold ( qint64 New_Long_Press_Milliseconds_Threshold );
 
+    // User input is recorded to the trace while it is recording, ...
+    // ... nullptr stops tracing.
+    void
+    Set_Keystroke_Trace ( KeystrokeTrace *New_Keystroke_Trace );
+
+    // Applies one record through the same entry point the user's ...
+    // ... input went through, see KeystrokeTrace::Replay.
+    void
+    Replay_Trace_Record ( const KeystrokeTrace::Trace_Record &Record );
+
 private:
     bool Numeric_Thin_Spaces = false;
+    bool Split_Insert_Units = false;
 
     bool Suppress_PlainTextChanged = false;
 
+    bool TextCursorIndicator_Shown = false;
+    // Follows edits made while it is shown
+    QTextCursor TextCursorIndicator_Cursor;
+
+    // End of the last document change, digit grouping looks only ...
+    // ... at the block holding it.
+    int Changed_Position = 0;
+
     // This supports less aggressive undo/redo command compression.
     // Normally any adjacent insert operations are treated as a single ...
     // ... undoable/redoable operation. When inserts are being made in ...
@@ -78,7 +118,31 @@ private:
     //Text block format changes.
     //Text block group format changes.
 
-    UndoRedo *Undo_Redo;
+    // Created by the manager on first edit, see Edit_History
+    UndoRedoManager *Undo_Redo_Manager;
+    UndoRedo *Undo_Redo = nullptr;
+
+    UndoRedo *Edit_History ( );
+
+    // Only user input handlers record, and only the outermost, e.g. ...
+    // ... not the undo() a Ctrl-Z key release calls. Recording_Input ...
+    // ... is set while one runs, and while the widget edits on its ...
+    // ... own (e.g. digit regrouping), so nothing called from there ...
+    // ... is recorded.
+    KeystrokeTrace *Keystroke_Trace = nullptr;
+    bool Recording_Input = false;
+
+    bool Begin_Trace_Input ( );
+    void End_Trace_Input ( bool Trace_Input );
+
+    // Autorepeated typing, Backspace and Delete are applied as each ...
+    // ... repeat arrives, w/o an undo boundary decision (or push) of ...
+    // ... their own: the press that began the run made it, so the ...
+    // ... press and its repeats undo as one unit.
+    int Autorepeat_Key = 0;
+
+    bool Is_Autorepeat_Key ( QKeyEvent *event );
+    bool Apply_Autorepeat ( QKeyEvent *event );
 
 public slots:
     void insertPlainText ( const QString &Text );
@@ -86,6 +150,10 @@ public slots:
 
     void Move_Cursor ( QTextCursor::MoveOperation Move_Operation );
 
+    // Ends the autorepeat run under way, a repeat from then on ...
+    // ... decides its own boundary (e.g. after a context menu cut)
+    void End_Autorepeat ( );
+
     void undo ( );
     void redo ( );
 
@@ -100,6 +168,7 @@ signals:
     void PlainTextChanged ( );
 
 private slots:
+    void Private_contentsChange ( int Position, int Chars_Removed, int Chars_Added );
     void Private_textChanged ( );
     // void Private_cursorPositionChanged ( );
 
@@ -110,6 +179,8 @@ protected:
     void focusInEvent ( QFocusEvent *event );
     void focusOutEvent ( QFocusEvent *event );
 
+    void paintEvent ( QPaintEvent *event );
+
 private:
     bool Support_Long_Press = false;
 
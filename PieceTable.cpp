@@ -0,0 +1,387 @@
+/**************************************************************************
+**
+** Copyright (C) 2022 Ken Crossen, example expanded into useful application
+**
+** "Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are
+** met:
+**   * Redistributions of source code must retain the above copyright
+**     notice, this list of conditions and the following disclaimer.
+**   * Redistributions in binary form must reproduce the above copyright
+**     notice, this list of conditions and the following disclaimer in
+**     the documentation and/or other materials provided with the
+**     distribution.
+**   * Redistributions in source code or binary form may not be sold.
+**
+**************************************************************************/
+
+#include "PieceTable.h"
+
+#include <QThreadPool>
+#include <QtConcurrent>
+
+PieceTable::PieceTable ( ) {
+    Clear();
+}
+
+void
+PieceTable::Clear ( ) {
+    Buffers.clear();
+    Buffers.append(Buffer_Block());
+    Document.clear();
+    Document_Length = 0;
+    Document_References.fill(0, 1);
+}
+
+void
+PieceTable::Load ( const QString &Original_Text ) {
+    Clear();
+    Buffers[0].Text = Original_Text;
+    if (Original_Text.length() > 0) {
+        Piece original_piece = { 0, 0, Original_Text.length() };
+        Document.append(original_piece);
+        Document_References[0] = 1;
+    }
+    Document_Length = Original_Text.length();
+}
+
+int
+PieceTable::Length ( ) const {
+    return Document_Length;
+}
+
+int
+PieceTable::Length ( const Piece_List &Pieces ) {
+    int length = 0;
+    for (const Piece &piece : Pieces) length += piece.Length;
+    return length;
+}
+
+PieceTable::Piece_List
+PieceTable::Pieces ( ) const {
+    return Document;
+}
+
+void
+PieceTable::Restore_Pieces ( const Piece_List &Snapshot ) {
+    Document = Snapshot;
+    Document_Length = 0;
+    Document_References.fill(0);
+    for (const Piece &piece : Document) {
+        Warm_Buffer_Text(piece.Buffer);
+        Document_Length += piece.Length;
+        Document_References[piece.Buffer] += 1;
+    }
+}
+
+PieceTable::Piece_List
+PieceTable::Slice ( int Position, int Count ) const {
+    return Slice(Document, Position, Count);
+}
+
+void
+PieceTable::Slice ( int Position, int Count, Piece_List &Slice_Pieces ) const {
+    Slice(Document, Position, Count, Slice_Pieces);
+}
+
+PieceTable::Piece_List
+PieceTable::Slice ( const Piece_List &Pieces, int Position, int Count ) {
+    Piece_List slice_pieces;
+    Slice(Pieces, Position, Count, slice_pieces);
+    return slice_pieces;
+}
+
+void
+PieceTable::Slice ( const Piece_List &Pieces, int Position, int Count, Piece_List &Slice_Pieces ) {
+    Slice_Pieces.resize(0);
+    int piece_position = 0;
+    for (const Piece &piece : Pieces) {
+        if (Count <= 0) break;
+        int piece_end = piece_position + piece.Length;
+        if (piece_end > Position) {
+            Piece slice_piece = piece;
+            int skip_length = qMax(0, Position - piece_position);
+            slice_piece.Start += skip_length;
+            slice_piece.Length = qMin(piece.Length - skip_length, Count);
+            Slice_Pieces.append(slice_piece);
+            Position += slice_piece.Length;
+            Count -= slice_piece.Length;
+        }
+        piece_position = piece_end;
+    }
+}
+
+QString
+PieceTable::Text ( ) const {
+    return Text(Document);
+}
+
+QString
+PieceTable::Text ( const Piece_List &Pieces ) const {
+    QString text;
+    text.reserve(Length(Pieces));
+    for (const Piece &piece : Pieces)
+        text.append(Warm_Buffer_Text(piece.Buffer).midRef(piece.Start, piece.Length));
+    return text;
+}
+
+PieceTable::Piece_List
+PieceTable::Append ( const QStringRef &New_Text ) {
+    Piece_List new_pieces;
+    Append(New_Text, new_pieces);
+    return new_pieces;
+}
+
+void
+PieceTable::Append ( const QStringRef &New_Text, Piece_List &New_Pieces ) {
+    New_Pieces.resize(0);
+    int text_position = 0;
+    while (text_position < New_Text.length()) {
+        if ((Buffers.count() == 1) or
+            (Buffers.last().Text.length() >= Piece_Table_Block_Size)) {
+            Buffers.append(Buffer_Block());
+            Buffers.last().Text.reserve(Piece_Table_Block_Size);
+            Document_References.append(0);
+        }
+        QString &add_buffer = Buffers.last().Text;
+        int copy_length = qMin(New_Text.length() - text_position,
+                               Piece_Table_Block_Size - add_buffer.length());
+        Piece new_piece = { Buffers.count() - 1, add_buffer.length(), copy_length };
+        add_buffer.append(New_Text.mid(text_position, copy_length));
+        New_Pieces.append(new_piece);
+        text_position += copy_length;
+    }
+}
+
+// Splits the piece containing Position so that a piece boundary ...
+// ... falls there, returns the index of the first piece at or after it.
+int
+PieceTable::Split ( int Position ) {
+    int piece_position = 0;
+    for (int piece_idx = 0; piece_idx < Document.count(); piece_idx += 1) {
+        Piece piece = Document.at(piece_idx);
+        if (Position == piece_position) return piece_idx;
+        if (Position < (piece_position + piece.Length)) {
+            int head_length = Position - piece_position;
+            Piece tail_piece = { piece.Buffer, piece.Start + head_length, piece.Length - head_length };
+            Document[piece_idx].Length = head_length;
+            Document.insert(piece_idx + 1, tail_piece);
+            Document_References[piece.Buffer] += 1;
+            return piece_idx + 1;
+        }
+        piece_position += piece.Length;
+    }
+    return Document.count();
+}
+
+PieceTable::Piece_List
+PieceTable::Replace ( int Position, int Count, const Piece_List &New_Pieces ) {
+    int begin_idx = Split(Position);
+    int end_idx = Split(Position + Count);
+
+    Piece_List removed_pieces = Document.mid(begin_idx, end_idx - begin_idx);
+    Document.remove(begin_idx, end_idx - begin_idx);
+    for (const Piece &piece : removed_pieces) Document_References[piece.Buffer] -= 1;
+
+    int insert_idx = begin_idx;
+    for (const Piece &piece : New_Pieces) {
+        if (piece.Length == 0) continue;
+        // The document is compared against constantly, keep it warm
+        Warm_Buffer_Text(piece.Buffer);
+        // Text typed in sequence lands contiguously in the add buffer, ...
+        // ... keep it as one piece
+        if ((insert_idx > 0) and
+            (Document.at(insert_idx - 1).Buffer == piece.Buffer) and
+            ((Document.at(insert_idx - 1).Start + Document.at(insert_idx - 1).Length) == piece.Start)) {
+            Document[insert_idx - 1].Length += piece.Length;
+        }
+        else {
+            Document.insert(insert_idx, piece);
+            Document_References[piece.Buffer] += 1;
+            insert_idx += 1;
+        }
+    }
+
+    Document_Length += Length(New_Pieces) - Count;
+    return removed_pieces;
+}
+
+int
+PieceTable::Common_Prefix ( const QString &Compare_Text ) const {
+    return Common_Prefix(Document, Compare_Text);
+}
+
+int
+PieceTable::Common_Suffix ( const QString &Compare_Text, int Limit ) const {
+    return Common_Suffix(Document, Compare_Text, Limit);
+}
+
+// Most comparisons end within a few characters, so the front is ...
+// ... compared here, only a long matching run goes to the thread pool.
+int
+PieceTable::Common_Prefix ( const Piece_List &Pieces, const QString &Compare_Text ) const {
+    int prefix_length = 0;
+    for (int piece_idx = 0; piece_idx < Pieces.count(); piece_idx += 1) {
+        const Piece &piece = Pieces.at(piece_idx);
+        const QChar *piece_data = Warm_Buffer_Text(piece.Buffer).constData() + piece.Start;
+        for (int ch_idx = 0; ch_idx < piece.Length; ch_idx += 1) {
+            // Still matching, the rest goes in chunks from here, ...
+            // ... in the middle of a (large) piece if need be
+            if (prefix_length >= Parallel_Compare_Minimum_Length)
+                return prefix_length + Parallel_Common_Prefix(Pieces, piece_idx, ch_idx, Compare_Text, prefix_length);
+            if ((prefix_length >= Compare_Text.length()) or
+                (not (piece_data[ch_idx] == Compare_Text.at(prefix_length))))
+                return prefix_length;
+            prefix_length += 1;
+        }
+    }
+    return prefix_length;
+}
+
+int
+PieceTable::Common_Suffix ( const Piece_List &Pieces, const QString &Compare_Text, int Limit ) const {
+    int suffix_length = 0;
+    for (int piece_idx = Pieces.count() - 1; piece_idx >= 0; piece_idx -= 1) {
+        const Piece &piece = Pieces.at(piece_idx);
+        const QChar *piece_data = Warm_Buffer_Text(piece.Buffer).constData() + piece.Start;
+        for (int ch_idx = piece.Length - 1; ch_idx >= 0; ch_idx -= 1) {
+            if (suffix_length >= Parallel_Compare_Minimum_Length)
+                return suffix_length + Parallel_Common_Suffix(Pieces, piece_idx, ch_idx + 1, Compare_Text,
+                                                              Compare_Text.length() - suffix_length,
+                                                              Limit - suffix_length);
+            if ((suffix_length >= Limit) or
+                (suffix_length >= Compare_Text.length()) or
+                (not (piece_data[ch_idx] == Compare_Text.at(Compare_Text.length() - suffix_length - 1))))
+                return suffix_length;
+            suffix_length += 1;
+        }
+    }
+    return suffix_length;
+}
+
+// From Piece_Offset into Pieces[Piece_Index] and Text_Position into ...
+// ... Compare_Text on, buffers are warmed here, the workers only read them
+int
+PieceTable::Parallel_Common_Prefix ( const Piece_List &Pieces, int Piece_Index, int Piece_Offset,
+                                     const QString &Compare_Text, int Text_Position ) const {
+    QVector<Compare_Chunk> compare_chunks;
+    for (int piece_idx = Piece_Index; piece_idx < Pieces.count(); piece_idx += 1) {
+        const Piece &piece = Pieces.at(piece_idx);
+        const QChar *piece_data = Warm_Buffer_Text(piece.Buffer).constData() + piece.Start;
+        int piece_offset = (piece_idx == Piece_Index) ? Piece_Offset : 0;
+        while ((piece_offset < piece.Length) and (Text_Position < Compare_Text.length())) {
+            int chunk_length = qMin(qMin(piece.Length - piece_offset,
+                                         Compare_Text.length() - Text_Position),
+                                    Parallel_Compare_Chunk_Length);
+            Compare_Chunk compare_chunk = { piece_data + piece_offset,
+                                            Compare_Text.constData() + Text_Position,
+                                            chunk_length, false };
+            compare_chunks.append(compare_chunk);
+            piece_offset += chunk_length;
+            Text_Position += chunk_length;
+        }
+    }
+    return Match_Chunks(compare_chunks);
+}
+
+// Back from Piece_End in Pieces[Piece_Index] and Text_End in ...
+// ... Compare_Text, at most Limit characters
+int
+PieceTable::Parallel_Common_Suffix ( const Piece_List &Pieces, int Piece_Index, int Piece_End,
+                                     const QString &Compare_Text, int Text_End, int Limit ) const {
+    QVector<Compare_Chunk> compare_chunks;
+    for (int piece_idx = Piece_Index; piece_idx >= 0; piece_idx -= 1) {
+        const Piece &piece = Pieces.at(piece_idx);
+        const QChar *piece_data = Warm_Buffer_Text(piece.Buffer).constData() + piece.Start;
+        int piece_end = (piece_idx == Piece_Index) ? Piece_End : piece.Length;
+        while ((piece_end > 0) and (Text_End > 0) and (Limit > 0)) {
+            int chunk_length = qMin(qMin(qMin(piece_end, Text_End), Limit),
+                                    Parallel_Compare_Chunk_Length);
+            Compare_Chunk compare_chunk = { piece_data + piece_end - chunk_length,
+                                            Compare_Text.constData() + Text_End - chunk_length,
+                                            chunk_length, true };
+            compare_chunks.append(compare_chunk);
+            piece_end -= chunk_length;
+            Text_End -= chunk_length;
+            Limit -= chunk_length;
+        }
+    }
+    return Match_Chunks(compare_chunks);
+}
+
+int
+PieceTable::Chunk_Match ( const Compare_Chunk &Chunk ) {
+    int match_length = 0;
+    if (Chunk.Backward) {
+        while ((match_length < Chunk.Length) and
+               (Chunk.Piece_Data[Chunk.Length - match_length - 1] ==
+                Chunk.Compare_Data[Chunk.Length - match_length - 1]))
+            match_length += 1;
+    }
+    else {
+        while ((match_length < Chunk.Length) and
+               (Chunk.Piece_Data[match_length] == Chunk.Compare_Data[match_length]))
+            match_length += 1;
+    }
+    return match_length;
+}
+
+// A round of chunks (one per pool thread) at a time, the chunks ...
+// ... past the first that differs are never compared.
+int
+PieceTable::Match_Chunks ( const QVector<Compare_Chunk> &Chunks ) {
+    int round_count = qMax(1, QThreadPool::globalInstance()->maxThreadCount());
+    int match_length = 0;
+    for (int round_begin = 0; round_begin < Chunks.count(); round_begin += round_count) {
+        QVector<Compare_Chunk> round_chunks = Chunks.mid(round_begin, round_count);
+        QVector<int> chunk_matches = QtConcurrent::blockingMapped<QVector<int> >(round_chunks, Chunk_Match);
+        for (int chunk_idx = 0; chunk_idx < round_chunks.count(); chunk_idx += 1) {
+            match_length += chunk_matches.at(chunk_idx);
+            if (chunk_matches.at(chunk_idx) < round_chunks.at(chunk_idx).Length) return match_length;
+        }
+    }
+    return match_length;
+}
+
+int
+PieceTable::Buffer_Count ( ) const {
+    return Buffers.count();
+}
+
+bool
+PieceTable::Is_Buffer_In_Document ( int Buffer ) const {
+    return (Document_References.at(Buffer) > 0);
+}
+
+// The add block still being appended to is never compressed
+bool
+PieceTable::Is_Buffer_Compressible ( int Buffer ) const {
+    return ((Buffers.at(Buffer).Compressed_Text.isEmpty()) and
+            (Buffers.at(Buffer).Text.length() > 0) and
+            (Document_References.at(Buffer) == 0) and
+            (not ((Buffer > 0) and (Buffer == (Buffers.count() - 1)))));
+}
+
+QString
+PieceTable::Buffer_Text ( int Buffer ) const {
+    return Buffers.at(Buffer).Text;
+}
+
+void
+PieceTable::Compress_Buffer ( int Buffer, const QByteArray &Compressed_Text ) {
+    if (not Is_Buffer_Compressible(Buffer)) return;
+    Buffers[Buffer].Compressed_Text = Compressed_Text;
+    Buffers[Buffer].Text = QString();
+}
+
+const QString &
+PieceTable::Warm_Buffer_Text ( int Buffer ) const {
+    Buffer_Block &buffer_block = Buffers[Buffer];
+    if (not buffer_block.Compressed_Text.isEmpty()) {
+        QByteArray raw_text = qUncompress(buffer_block.Compressed_Text);
+        buffer_block.Text = QString(reinterpret_cast<const QChar*>(raw_text.constData()),
+                                    raw_text.size() / int(sizeof(QChar)));
+        buffer_block.Compressed_Text = QByteArray();
+    }
+    return buffer_block.Text;
+}
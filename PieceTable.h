@@ -0,0 +1,134 @@
+/**************************************************************************
+**
+** Copyright (C) 2022 Ken Crossen, example expanded into useful application
+**
+** "Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are
+** met:
+**   * Redistributions of source code must retain the above copyright
+**     notice, this list of conditions and the following disclaimer.
+**   * Redistributions in binary form must reproduce the above copyright
+**     notice, this list of conditions and the following disclaimer in
+**     the documentation and/or other materials provided with the
+**     distribution.
+**   * Redistributions in source code or binary form may not be sold.
+**
+**************************************************************************/
+
+#ifndef PIECETABLE_H
+#define PIECETABLE_H
+
+#include <QByteArray>
+#include <QString>
+#include <QStringRef>
+#include <QVector>
+
+// The original text plus an append-only add buffer, the document is ...
+// ... the ordered list of pieces (spans of those buffers).
+// Buffers are never modified once written, so piece lists stay valid ...
+// ... and can be freely shared between the document and undo records.
+// Piece lists are implicitly shared, so a snapshot costs O(1) and ...
+// ... an edit of the snapshot costs O(pieces), never O(characters).
+class PieceTable {
+public:
+    struct Piece {
+        int Buffer;
+        int Start;
+        int Length;
+    };
+    typedef QVector<Piece> Piece_List;
+
+    PieceTable ( );
+
+    void Clear ( );
+    void Load ( const QString &Original_Text );
+
+    int Length ( ) const;
+    static int Length ( const Piece_List &Pieces );
+
+    Piece_List Pieces ( ) const;
+    // Makes a snapshot taken by Pieces the document again, O(1) ...
+    // ... but for warming the buffers it uses.
+    void Restore_Pieces ( const Piece_List &Snapshot );
+    Piece_List Slice ( int Position, int Count ) const;
+    static Piece_List Slice ( const Piece_List &Pieces, int Position, int Count );
+    // Into Slice_Pieces, whose capacity is reused
+    void Slice ( int Position, int Count, Piece_List &Slice_Pieces ) const;
+    static void Slice ( const Piece_List &Pieces, int Position, int Count, Piece_List &Slice_Pieces );
+
+    QString Text ( ) const;
+    QString Text ( const Piece_List &Pieces ) const;
+
+    // Copies the text into the add buffer once, the returned pieces ...
+    // ... refer to it from then on.
+    Piece_List Append ( const QStringRef &New_Text );
+    void Append ( const QStringRef &New_Text, Piece_List &New_Pieces );
+
+    // Replaces Count characters at Position w/ New_Pieces, ...
+    // ... returns the pieces that were removed.
+    Piece_List Replace ( int Position, int Count, const Piece_List &New_Pieces );
+
+    // Length of the run shared w/ Compare_Text at the front, ...
+    // ... and at the back (at most Limit characters).
+    // Runs still matching after Parallel_Compare_Minimum_Length ...
+    // ... characters (even within one piece) are compared in chunks ...
+    // ... across the thread pool, a round at a time.
+    int Common_Prefix ( const QString &Compare_Text ) const;
+    int Common_Suffix ( const QString &Compare_Text, int Limit ) const;
+    // The same for the text of Pieces rather than the document
+    int Common_Prefix ( const Piece_List &Pieces, const QString &Compare_Text ) const;
+    int Common_Suffix ( const Piece_List &Pieces, const QString &Compare_Text, int Limit ) const;
+
+    // A buffer the document no longer uses may be compressed (e.g. on ...
+    // ... a worker thread, from a copy of Buffer_Text), it is ...
+    // ... decompressed again the first time a piece of it is read.
+    int Buffer_Count ( ) const;
+    bool Is_Buffer_In_Document ( int Buffer ) const;
+    bool Is_Buffer_Compressible ( int Buffer ) const;
+    QString Buffer_Text ( int Buffer ) const;
+    void Compress_Buffer ( int Buffer, const QByteArray &Compressed_Text );
+
+private:
+    struct Buffer_Block {
+        QString Text;
+        QByteArray Compressed_Text;
+    };
+
+    // Buffers[0] is the original text, the rest is the add buffer, ...
+    // ... grown in blocks so appending never copies earlier text.
+    // Mutable so reading can decompress a cold buffer in place.
+    mutable QVector<Buffer_Block> Buffers;
+    Piece_List Document;
+    int Document_Length;
+    // Document pieces per buffer, kept up to date by each edit ...
+    // ... so no one has to scan the document to find them
+    QVector<int> Document_References;
+
+    int Split ( int Position );
+    const QString &Warm_Buffer_Text ( int Buffer ) const;
+
+#define Piece_Table_Block_Size 65536
+#define Parallel_Compare_Minimum_Length 262144
+#define Parallel_Compare_Chunk_Length 65536
+
+    // Length characters of a piece and of the compared text, ...
+    // ... Backward chunks are matched from their end.
+    struct Compare_Chunk {
+        const QChar *Piece_Data;
+        const QChar *Compare_Data;
+        int Length;
+        bool Backward;
+    };
+
+    int Parallel_Common_Prefix ( const Piece_List &Pieces, int Piece_Index, int Piece_Offset,
+                                 const QString &Compare_Text, int Text_Position ) const;
+    int Parallel_Common_Suffix ( const Piece_List &Pieces, int Piece_Index, int Piece_End,
+                                 const QString &Compare_Text, int Text_End, int Limit ) const;
+
+    static int Chunk_Match ( const Compare_Chunk &Chunk );
+    // Characters matched up to the first chunk that did not match ...
+    // ... through, the chunks are in comparison order.
+    static int Match_Chunks ( const QVector<Compare_Chunk> &Chunks );
+};
+
+#endif // PIECETABLE_H
@@ -0,0 +1,100 @@
+/**************************************************************************
+**
+** Copyright (C) 2022 Ken Crossen, example expanded into useful application
+**
+** "Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are
+** met:
+**   * Redistributions of source code must retain the above copyright
+**     notice, this list of conditions and the following disclaimer.
+**   * Redistributions in binary form must reproduce the above copyright
+**     notice, this list of conditions and the following disclaimer in
+**     the documentation and/or other materials provided with the
+**     distribution.
+**   * Redistributions in source code or binary form may not be sold.
+**
+**************************************************************************/
+
+
+#ifndef RINGBUFFER_H
+#define RINGBUFFER_H
+
+#include <QVector>
+
+// Fixed-capacity stack that drops its oldest item when full.
+// Push, pop and evicting the oldest item are all O(1), nothing is ...
+// ... shifted the way QStack::removeFirst shifts a QVector.
+// Slots are allocated as items arrive, doubling up to the capacity, ...
+// ... so a history that is never used costs nothing.
+// Index 0 is the oldest item, count() - 1 the top.
+template <typename T>
+class RingBuffer {
+public:
+#define Ring_Buffer_Minimum_Slot_Count 4
+
+    explicit RingBuffer ( int New_Capacity = 1 ) {
+        setCapacity(New_Capacity);
+    }
+
+    int capacity ( ) const { return Capacity; }
+    int count ( ) const { return Count; }
+    bool isEmpty ( ) const { return (Count == 0); }
+
+    // Keeps the newest items that still fit
+    void setCapacity ( int New_Capacity ) {
+        Capacity = qMax(1, New_Capacity);
+        while (Count > Capacity) removeFirst();
+        if (Items.count() > Capacity) Reallocate(Capacity);
+    }
+
+    const T &at ( int Index ) const { return Items.at(Slot(Index)); }
+    T &operator[] ( int Index ) { return Items[Slot(Index)]; }
+
+    const T &first ( ) const { return at(0); }
+    const T &top ( ) const { return at(Count - 1); }
+    T &top ( ) { return (*this)[Count - 1]; }
+
+    void push ( const T &Item ) {
+        if (Count == Capacity) removeFirst();
+        else if (Count == Items.count()) Reallocate(qMin(Capacity, qMax(Ring_Buffer_Minimum_Slot_Count, Items.count() * 2)));
+        Items[Slot(Count)] = Item;
+        Count += 1;
+    }
+
+    T pop ( ) {
+        T item = top();
+        // Release whatever the slot holds now rather than at reuse
+        top() = T();
+        Count -= 1;
+        return item;
+    }
+
+    void removeFirst ( ) {
+        Items[First] = T();
+        First = (First + 1) % Items.count();
+        Count -= 1;
+    }
+
+    void clear ( ) {
+        while (Count > 0) removeFirst();
+        First = 0;
+    }
+
+private:
+    QVector<T> Items;
+    int Capacity = 1;
+    int First = 0;
+    int Count = 0;
+
+    int Slot ( int Index ) const { return (First + Index) % Items.count(); }
+
+    // Slot_Count must hold the items there are, oldest goes to slot 0
+    void Reallocate ( int Slot_Count ) {
+        QVector<T> new_items(Slot_Count);
+        for (int item_idx = 0; item_idx < Count; item_idx += 1) new_items[item_idx] = at(item_idx);
+        Items = new_items;
+        First = 0;
+    }
+};
+
+#endif // RINGBUFFER_H
@@ -0,0 +1,31 @@
+/**************************************************************************
+**
+** Copyright (C) 2022 Ken Crossen, example expanded into useful application
+**
+** "Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are
+** met:
+**   * Redistributions of source code must retain the above copyright
+**     notice, this list of conditions and the following disclaimer.
+**   * Redistributions in binary form must reproduce the above copyright
+**     notice, this list of conditions and the following disclaimer in
+**     the documentation and/or other materials provided with the
+**     distribution.
+**   * Redistributions in source code or binary form may not be sold.
+**
+**************************************************************************/
+
+#ifndef LINEEDIT_H
+#define LINEEDIT_H
+
+#include <QLineEdit>
+
+// Stands in for the host application's LineEdit, UndoRedo uses ...
+// ... nothing QLineEdit doesn't have.
+class LineEdit : public QLineEdit {
+    Q_OBJECT
+public:
+    explicit LineEdit ( QWidget *parent = nullptr ) : QLineEdit(parent) { }
+};
+
+#endif // LINEEDIT_H
@@ -0,0 +1,27 @@
+/**************************************************************************
+**
+** Copyright (C) 2022 Ken Crossen, example expanded into useful application
+**
+** "Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are
+** met:
+**   * Redistributions of source code must retain the above copyright
+**     notice, this list of conditions and the following disclaimer.
+**   * Redistributions in binary form must reproduce the above copyright
+**     notice, this list of conditions and the following disclaimer in
+**     the documentation and/or other materials provided with the
+**     distribution.
+**   * Redistributions in source code or binary form may not be sold.
+**
+**************************************************************************/
+
+#ifndef UI_DEFINES_H
+#define UI_DEFINES_H
+
+#include <QChar>
+
+// Stands in for the host application's UI_Defines.h, only this ...
+// ... is used from it.
+#define Unicode_Thin_Space QChar(0x2009)
+
+#endif // UI_DEFINES_H
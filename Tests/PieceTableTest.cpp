@@ -0,0 +1,235 @@
+/**************************************************************************
+**
+** Copyright (C) 2022 Ken Crossen, example expanded into useful application
+**
+** "Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are
+** met:
+**   * Redistributions of source code must retain the above copyright
+**     notice, this list of conditions and the following disclaimer.
+**   * Redistributions in binary form must reproduce the above copyright
+**     notice, this list of conditions and the following disclaimer in
+**     the documentation and/or other materials provided with the
+**     distribution.
+**   * Redistributions in source code or binary form may not be sold.
+**
+**************************************************************************/
+
+
+#include <QtTest>
+
+#include "PieceTable.h"
+
+class PieceTableTest : public QObject {
+    Q_OBJECT
+
+private slots:
+    void Random_Edits ( );
+    void Snapshots ( );
+    void Compressed_Buffers ( );
+    void Common_Prefix_Suffix_data ( );
+    void Common_Prefix_Suffix ( );
+
+private:
+    quint32 Seed = 1;
+    int Random ( int Bound );
+    QString Random_Text ( int Length );
+
+    static int Naive_Prefix ( const QString &Text, const QString &Compare_Text );
+    static int Naive_Suffix ( const QString &Text, const QString &Compare_Text, int Limit );
+};
+
+int
+PieceTableTest::Random ( int Bound ) {
+    Seed = (Seed * 1103515245) + 12345;
+    return int((Seed >> 8) % quint32(qMax(1, Bound)));
+}
+
+QString
+PieceTableTest::Random_Text ( int Length ) {
+    QString text;
+    text.reserve(Length);
+    for (int ch_idx = 0; ch_idx < Length; ch_idx += 1) text.append(QChar('a' + Random(26)));
+    return text;
+}
+
+int
+PieceTableTest::Naive_Prefix ( const QString &Text, const QString &Compare_Text ) {
+    int prefix_length = 0;
+    int shorter_length = qMin(Text.length(), Compare_Text.length());
+    while ((prefix_length < shorter_length) and (Text.at(prefix_length) == Compare_Text.at(prefix_length)))
+        prefix_length += 1;
+    return prefix_length;
+}
+
+int
+PieceTableTest::Naive_Suffix ( const QString &Text, const QString &Compare_Text, int Limit ) {
+    int suffix_length = 0;
+    int shorter_length = qMin(qMin(Text.length(), Compare_Text.length()), Limit);
+    while ((suffix_length < shorter_length) and
+           (Text.at(Text.length() - 1 - suffix_length) == Compare_Text.at(Compare_Text.length() - 1 - suffix_length)))
+        suffix_length += 1;
+    return suffix_length;
+}
+
+// Against a QString getting the same edits
+void
+PieceTableTest::Random_Edits ( ) {
+    Seed = 1;
+    QString expected = Random_Text(500);
+    PieceTable table;
+    table.Load(expected);
+
+    for (int edit_idx = 0; edit_idx < 2000; edit_idx += 1) {
+        int position = Random(expected.length() + 1);
+        int remove_count = Random(qMin(20, expected.length() - position) + 1);
+        QString insert_text = Random_Text(Random(12));
+
+        PieceTable::Piece_List removed = table.Replace(position, remove_count, table.Append(QStringRef(&insert_text)));
+        QCOMPARE(table.Text(removed), expected.mid(position, remove_count));
+        expected.replace(position, remove_count, insert_text);
+
+        QCOMPARE(table.Length(), expected.length());
+        if ((edit_idx % 50) == 0) {
+            QCOMPARE(table.Text(), expected);
+            int slice_position = Random(expected.length() + 1);
+            int slice_count = Random(expected.length() - slice_position + 1);
+            QCOMPARE(table.Text(table.Slice(slice_position, slice_count)), expected.mid(slice_position, slice_count));
+        }
+    }
+    QCOMPARE(table.Text(), expected);
+}
+
+void
+PieceTableTest::Snapshots ( ) {
+    Seed = 2;
+    PieceTable table;
+    table.Load(Random_Text(1000));
+
+    QVector<PieceTable::Piece_List> snapshots;
+    QStringList snapshot_texts;
+    for (int edit_idx = 0; edit_idx < 200; edit_idx += 1) {
+        snapshots.append(table.Pieces());
+        snapshot_texts.append(table.Text());
+
+        QString insert_text = Random_Text(Random(30));
+        int position = Random(table.Length() + 1);
+        table.Replace(position, Random(qMin(30, table.Length() - position) + 1), table.Append(QStringRef(&insert_text)));
+    }
+
+    // Any order, each one is the document again
+    for (int restore_idx = 0; restore_idx < 400; restore_idx += 1) {
+        int snapshot_idx = Random(snapshots.count());
+        table.Restore_Pieces(snapshots.at(snapshot_idx));
+        QCOMPARE(table.Text(), snapshot_texts.at(snapshot_idx));
+        QCOMPARE(table.Length(), snapshot_texts.at(snapshot_idx).length());
+    }
+}
+
+// As the history compresses them, see UndoRedo::Schedule_Compression
+void
+PieceTableTest::Compressed_Buffers ( ) {
+    Seed = 3;
+    PieceTable table;
+    table.Load(Random_Text(100000));
+
+    QVector<PieceTable::Piece_List> snapshots;
+    QStringList snapshot_texts;
+    for (int edit_idx = 0; edit_idx < 50; edit_idx += 1) {
+        snapshots.append(table.Pieces());
+        snapshot_texts.append(table.Text());
+
+        QString insert_text = Random_Text(5000);
+        int position = Random(table.Length() + 1);
+        table.Replace(position, Random(qMin(5000, table.Length() - position) + 1), table.Append(QStringRef(&insert_text)));
+    }
+    // Nothing the document uses may be compressed
+    QString last_text = QStringLiteral("The end");
+    table.Replace(0, table.Length(), table.Append(QStringRef(&last_text)));
+
+    int compressed_count = 0;
+    for (int buffer_idx = 0; buffer_idx < table.Buffer_Count(); buffer_idx += 1) {
+        if (table.Is_Buffer_In_Document(buffer_idx)) {
+            QVERIFY(not table.Is_Buffer_Compressible(buffer_idx));
+            continue;
+        }
+        if (not table.Is_Buffer_Compressible(buffer_idx)) continue;
+
+        QString buffer_text = table.Buffer_Text(buffer_idx);
+        table.Compress_Buffer(buffer_idx,
+                              qCompress(QByteArray(reinterpret_cast<const char*>(buffer_text.constData()),
+                                                   buffer_text.length() * int(sizeof(QChar)))));
+        compressed_count += 1;
+    }
+    QVERIFY(compressed_count > 0);
+    QCOMPARE(table.Text(), last_text);
+
+    for (int snapshot_idx = snapshots.count() - 1; snapshot_idx >= 0; snapshot_idx -= 1) {
+        table.Restore_Pieces(snapshots.at(snapshot_idx));
+        QCOMPARE(table.Text(), snapshot_texts.at(snapshot_idx));
+    }
+}
+
+// Lengths span the parallel compare (Parallel_Compare_Minimum_Length), ...
+// ... differences fall either side of its chunk boundaries.
+void
+PieceTableTest::Common_Prefix_Suffix_data ( ) {
+    QTest::addColumn<int>("Text_Length");
+    QTest::addColumn<int>("Piece_Count");
+
+    QTest::newRow("short, one piece") << 1000 << 1;
+    QTest::newRow("short, many pieces") << 1000 << 40;
+    QTest::newRow("long, one piece") << 1000000 << 1;
+    QTest::newRow("long, few pieces") << 1000000 << 3;
+    QTest::newRow("long, many pieces") << 1000000 << 200;
+}
+
+void
+PieceTableTest::Common_Prefix_Suffix ( ) {
+    QFETCH(int, Text_Length);
+    QFETCH(int, Piece_Count);
+
+    Seed = 4;
+    QString text = Random_Text(Text_Length);
+    PieceTable table;
+    table.Load(text);
+    // Same text, cut into pieces of the add buffer
+    for (int piece_idx = 1; piece_idx < Piece_Count; piece_idx += 1) {
+        int position = Random(Text_Length);
+        int count = qMin(Random(5000) + 1, Text_Length - position);
+        QString same_text = text.mid(position, count);
+        table.Replace(position, count, table.Append(QStringRef(&same_text)));
+    }
+    QCOMPARE(table.Text(), text);
+    PieceTable::Piece_List pieces = table.Pieces();
+
+    QVector<int> positions = { 0, 1, Text_Length / 2, Text_Length - 1 };
+    for (int boundary : { 65535, 65536, 65537, 262143, 262144, 262145, 524288, 600001 })
+        if (boundary < Text_Length) positions.append(boundary);
+    for (int random_idx = 0; random_idx < 10; random_idx += 1) positions.append(Random(Text_Length));
+
+    for (int position : positions) {
+        QString changed_text = text;
+        changed_text[position] = QChar('A');
+        QString shorter_text = text.left(position);
+        QString longer_text = text + QStringLiteral("tail");
+        QString front_text = QStringLiteral("head") + text.mid(position);
+
+        for (const QString &compare_text : { changed_text, shorter_text, longer_text, front_text }) {
+            int prefix_length = Naive_Prefix(text, compare_text);
+            QCOMPARE(table.Common_Prefix(compare_text), prefix_length);
+            QCOMPARE(table.Common_Prefix(pieces, compare_text), prefix_length);
+
+            int limit = qMin(Text_Length, compare_text.length()) - prefix_length;
+            int suffix_length = Naive_Suffix(text, compare_text, limit);
+            QCOMPARE(table.Common_Suffix(compare_text, limit), suffix_length);
+            QCOMPARE(table.Common_Suffix(pieces, compare_text, limit), suffix_length);
+            // Stops at the limit, even in the middle of a match
+            QCOMPARE(table.Common_Suffix(compare_text, limit / 2), qMin(suffix_length, limit / 2));
+        }
+    }
+}
+
+QTEST_GUILESS_MAIN(PieceTableTest)
+
+#include "PieceTableTest.moc"
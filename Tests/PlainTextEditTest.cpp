@@ -0,0 +1,319 @@
+/**************************************************************************
+**
+** Copyright (C) 2022 Ken Crossen, example expanded into useful application
+**
+** "Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are
+** met:
+**   * Redistributions of source code must retain the above copyright
+**     notice, this list of conditions and the following disclaimer.
+**   * Redistributions in binary form must reproduce the above copyright
+**     notice, this list of conditions and the following disclaimer in
+**     the documentation and/or other materials provided with the
+**     distribution.
+**   * Redistributions in source code or binary form may not be sold.
+**
+**************************************************************************/
+
+#include <QtTest>
+#include <QTemporaryDir>
+
+#include "PlainTextEdit.h"
+#include "KeystrokeTrace.h"
+#include "UndoRedoManager.h"
+
+// The example widget, shown on the offscreen platform and typed ...
+// ... into through QTest: undo units (also journaled), histories ...
+// ... across widgets, digit grouping, split inserts, keystroke ...
+// ... trace replay, the cursor indicator and autorepeat units.
+class PlainTextEditTest : public QObject {
+    Q_OBJECT
+
+private slots:
+    void Typing_Units ( );
+    void Typing_Journaled ( );
+    void Shared_Manager ( );
+    void Digit_Grouping_data ( );
+    void Digit_Grouping ( );
+    void Digit_Grouping_Changed_Block ( );
+    void Split_Insert_Units_data ( );
+    void Split_Insert_Units ( );
+    void Trace_Replay ( );
+    void Cursor_Indicator ( );
+    void Autorepeat_Units ( );
+
+private:
+    static bool Show ( PlainTextEdit &Edit );
+    // The platform's first binding, e.g. Ctrl-Z for QKeySequence::Undo
+    static void Press_Standard_Key ( PlainTextEdit &Edit, QKeySequence::StandardKey Standard_Key );
+    static void Send_Key ( PlainTextEdit &Edit, QEvent::Type Type, int Key, const QString &Text, bool Auto_Repeat );
+};
+
+bool
+PlainTextEditTest::Show ( PlainTextEdit &Edit ) {
+    Edit.show();
+    return QTest::qWaitForWindowExposed(&Edit);
+}
+
+void
+PlainTextEditTest::Press_Standard_Key ( PlainTextEdit &Edit, QKeySequence::StandardKey Standard_Key ) {
+    int key_combination = QKeySequence(Standard_Key)[0];
+    QTest::keyClick(&Edit, Qt::Key(key_combination & ~Qt::KeyboardModifierMask),
+                    Qt::KeyboardModifiers(key_combination & Qt::KeyboardModifierMask));
+}
+
+void
+PlainTextEditTest::Send_Key ( PlainTextEdit &Edit, QEvent::Type Type, int Key, const QString &Text, bool Auto_Repeat ) {
+    QKeyEvent key_event(Type, Key, Qt::NoModifier, Text, Auto_Repeat);
+    QApplication::sendEvent(&Edit, &key_event);
+}
+
+// "local angle; local sin4; while" undoes "while", then "sin4; "
+void
+PlainTextEditTest::Typing_Units ( ) {
+    PlainTextEdit edit;
+    QVERIFY(Show(edit));
+
+    QString typed_text = QStringLiteral("local angle; local sin4; while");
+    QTest::keyClicks(&edit, typed_text);
+    QCOMPARE(edit.toPlainText_Clean(), typed_text);
+
+    Press_Standard_Key(edit, QKeySequence::Undo);
+    QCOMPARE(edit.toPlainText_Clean(), QStringLiteral("local angle; local sin4; "));
+    Press_Standard_Key(edit, QKeySequence::Undo);
+    QCOMPARE(edit.toPlainText_Clean(), QStringLiteral("local angle; local "));
+    Press_Standard_Key(edit, QKeySequence::Redo);
+    QCOMPARE(edit.toPlainText_Clean(), QStringLiteral("local angle; local sin4; "));
+    Press_Standard_Key(edit, QKeySequence::Redo);
+    QCOMPARE(edit.toPlainText_Clean(), typed_text);
+}
+
+// Each typed unit is in the journal as soon as the next one begins, ...
+// ... a session gone w/o Close_Journal (as if crashed) loses only ...
+// ... the unit still being typed
+void
+PlainTextEditTest::Typing_Journaled ( ) {
+    QTemporaryDir journal_dir;
+    QVERIFY(journal_dir.isValid());
+    QString journal_path = journal_dir.filePath(QStringLiteral("document.journal"));
+
+    {
+        PlainTextEdit edit;
+        QVERIFY(Show(edit));
+        QVERIFY(UndoRedoManager::Shared()->History(&edit)->Open_Journal(journal_path));
+        QTest::keyClicks(&edit, QStringLiteral("local angle; local sin4; while"));
+    }
+
+    PlainTextEdit edit;
+    edit.setPlainText(QStringLiteral("local angle; local sin4; "));
+    QVERIFY(Show(edit));
+    QVERIFY(UndoRedoManager::Shared()->History(&edit)->Open_Journal(journal_path));
+    Press_Standard_Key(edit, QKeySequence::Undo);
+    QCOMPARE(edit.toPlainText_Clean(), QStringLiteral("local angle; local "));
+    Press_Standard_Key(edit, QKeySequence::Redo);
+    QCOMPARE(edit.toPlainText_Clean(), QStringLiteral("local angle; local sin4; "));
+    UndoRedoManager::Shared()->History(&edit)->Close_Journal();
+}
+
+// Histories come w/ the first edit and go w/ the widget, the ...
+// ... most recent edit of all is undone first
+void
+PlainTextEditTest::Shared_Manager ( ) {
+    UndoRedoManager manager;
+    PlainTextEdit first_edit;
+    PlainTextEdit *second_edit = new PlainTextEdit();
+    first_edit.Set_Undo_Redo_Manager(&manager);
+    second_edit->Set_Undo_Redo_Manager(&manager);
+    QVERIFY(Show(first_edit));
+    QVERIFY(Show(*second_edit));
+    QCOMPARE(manager.History_Count(), 0);
+
+    QTest::keyClicks(&first_edit, QStringLiteral("local angle; "));
+    QTest::keyClicks(second_edit, QStringLiteral("local sin4; "));
+    QCOMPARE(manager.History_Count(), 2);
+    // No timer or watcher objects while idle
+    QCOMPARE(manager.History(&first_edit)->children().count(), 0);
+
+    QCOMPARE(manager.Undo_Widget(), static_cast<QWidget*>(second_edit));
+    QVERIFY(manager.Undo_Last());
+    QCOMPARE(second_edit->toPlainText_Clean(), QStringLiteral("local "));
+    QCOMPARE(manager.Undo_Widget(), static_cast<QWidget*>(&first_edit));
+
+    delete second_edit;
+    QCOMPARE(manager.History_Count(), 1);
+}
+
+void
+PlainTextEditTest::Digit_Grouping_data ( ) {
+    QTest::addColumn<QString>("Typed_Text");
+    QTest::addColumn<QString>("Grouped_Text");
+
+    // '_' stands for the thin space
+    QTest::newRow("decimal") << "x = 1234567" << "x = 1_234_567";
+    QTest::newRow("fraction") << "x = 3.14159" << "x = 3.141_59";
+    QTest::newRow("hexadecimal") << "x = 0x1234abcd" << "x = 0x1234_abcd";
+    QTest::newRow("binary") << "x = 0b10110011" << "x = 0b1011_0011";
+    QTest::newRow("short") << "x = 123" << "x = 123";
+    QTest::newRow("identifier") << "x1234567" << "x1234567";
+}
+
+// Regrouped as each digit is typed
+void
+PlainTextEditTest::Digit_Grouping ( ) {
+    QFETCH(QString, Typed_Text);
+    QFETCH(QString, Grouped_Text);
+
+    PlainTextEdit edit;
+    edit.Set_Numeric_Thin_Spaces(true);
+    QVERIFY(Show(edit));
+
+    QTest::keyClicks(&edit, Typed_Text);
+    QCOMPARE(edit.toPlainText_Clean(), Grouped_Text.replace(QChar('_'), Unicode_Thin_Space));
+    QCOMPARE(edit.toPlainText_Clean_No_ThinSpace(), Typed_Text);
+}
+
+// Only the block holding the change is scanned
+void
+PlainTextEditTest::Digit_Grouping_Changed_Block ( ) {
+    PlainTextEdit edit;
+    edit.Set_Numeric_Thin_Spaces(true);
+    QVERIFY(Show(edit));
+
+    edit.setPlainText(QStringLiteral("x = 1234567\n"));
+    edit.moveCursor(QTextCursor::End);
+    QTest::keyClicks(&edit, QStringLiteral("y = 7654321"));
+    QCOMPARE(edit.toPlainText_Clean(),
+             QStringLiteral("x = 1234567\ny = 7_654_321").replace(QChar('_'), Unicode_Thin_Space));
+}
+
+void
+PlainTextEditTest::Split_Insert_Units_data ( ) {
+    QTest::addColumn<bool>("Split_Insert_Units");
+    QTest::addColumn<int>("Boundary_Policy");
+    QTest::addColumn<QString>("Inserted_Text");
+    QTest::addColumn<QString>("Undone_Text");
+
+    QTest::newRow("whole") << false << int(BoundaryPolicy::C_Like)
+                           << "local angle; local sin4; while" << "";
+    QTest::newRow("split") << true << int(BoundaryPolicy::C_Like)
+                           << "local angle; local sin4; while" << "local angle; local sin4; ";
+    // Apostrophes and hyphens continue a word, "well-" would be left
+    QTest::newRow("split prose") << true << int(BoundaryPolicy::Prose)
+                                 << "it's well-known" << "it's ";
+}
+
+// An insert (e.g. a keypad slot) undone at once, or unit by unit
+void
+PlainTextEditTest::Split_Insert_Units ( ) {
+    QFETCH(bool, Split_Insert_Units);
+    QFETCH(int, Boundary_Policy);
+    QFETCH(QString, Inserted_Text);
+    QFETCH(QString, Undone_Text);
+
+    PlainTextEdit edit;
+    edit.Set_Split_Insert_Units(Split_Insert_Units);
+    UndoRedoManager::Shared()->History(&edit)->Set_Boundary_Policy(BoundaryPolicy::Policy(Boundary_Policy));
+    QVERIFY(Show(edit));
+
+    edit.insertPlainText(Inserted_Text);
+    QCOMPARE(edit.toPlainText_Clean(), Inserted_Text);
+
+    Press_Standard_Key(edit, QKeySequence::Undo);
+    QCOMPARE(edit.toPlainText_Clean(), Undone_Text);
+    Press_Standard_Key(edit, QKeySequence::Redo);
+    QCOMPARE(edit.toPlainText_Clean(), Inserted_Text);
+}
+
+// A replayed session ends w/ the same text and the same history
+void
+PlainTextEditTest::Trace_Replay ( ) {
+    QTemporaryDir trace_dir;
+    QVERIFY(trace_dir.isValid());
+    QString trace_path = trace_dir.filePath(QStringLiteral("session.trace"));
+
+    PlainTextEdit edit;
+    QVERIFY(Show(edit));
+    KeystrokeTrace trace;
+    QVERIFY(trace.Start_Recording(trace_path));
+    edit.Set_Keystroke_Trace(&trace);
+
+    QTest::keyClicks(&edit, QStringLiteral("local angle; local sin4;"));
+    Press_Standard_Key(edit, QKeySequence::Undo);
+    QTest::keyClicks(&edit, QStringLiteral("sine; x = 12345"));
+    QTest::keyClick(&edit, Qt::Key_Backspace);
+    edit.insertPlainText(QStringLiteral(" while"));
+    Press_Standard_Key(edit, QKeySequence::Undo);
+    Press_Standard_Key(edit, QKeySequence::Redo);
+    // Cut through the slot (e.g. a menu action), not a key event
+    for (int select_idx = 0; select_idx < 5; select_idx += 1)
+        QTest::keyClick(&edit, Qt::Key_Left, Qt::ShiftModifier);
+    edit.cut();
+    QVERIFY(not edit.toPlainText_Clean().endsWith(QStringLiteral("while")));
+
+    edit.Set_Keystroke_Trace(nullptr);
+    trace.Stop_Recording();
+
+    PlainTextEdit replayed_edit;
+    QVERIFY(Show(replayed_edit));
+    KeystrokeTrace replayed_trace;
+    QVERIFY(replayed_trace.Load(trace_path));
+    QVERIFY(replayed_trace.Record_Count() > 0);
+    replayed_trace.Replay(&replayed_edit, false);
+    QCOMPARE(replayed_edit.toPlainText_Clean(), edit.toPlainText_Clean());
+
+    for (int undo_idx = 0; undo_idx < 6; undo_idx += 1) {
+        Press_Standard_Key(edit, QKeySequence::Undo);
+        Press_Standard_Key(replayed_edit, QKeySequence::Undo);
+        QCOMPARE(replayed_edit.toPlainText_Clean(), edit.toPlainText_Clean());
+    }
+}
+
+// Painted over the text, never part of it, and gone w/ the next edit
+void
+PlainTextEditTest::Cursor_Indicator ( ) {
+    PlainTextEdit edit;
+    QVERIFY(Show(edit));
+    edit.setPlainText(QStringLiteral("local angle"));
+    edit.moveCursor(QTextCursor::End);
+
+    edit.insertTextCursorIndicator();
+    QVERIFY(edit.Has_TextCursorIndicator());
+    edit.viewport()->repaint();
+    QCOMPARE(edit.toPlainText(), QStringLiteral("local angle"));
+
+    QTest::keyClick(&edit, ';');
+    QVERIFY(not edit.Has_TextCursorIndicator());
+    QCOMPARE(edit.toPlainText(), QStringLiteral("local angle;"));
+}
+
+// Each repeat lands at once, a press and its repeats undo as one unit
+void
+PlainTextEditTest::Autorepeat_Units ( ) {
+    PlainTextEdit edit;
+    QVERIFY(Show(edit));
+    QTest::keyClicks(&edit, QStringLiteral("x = "));
+
+    QString typed_text = QStringLiteral("x = a");
+    Send_Key(edit, QEvent::KeyPress, Qt::Key_A, QStringLiteral("a"), false);
+    for (int repeat_idx = 0; repeat_idx < 4; repeat_idx += 1) {
+        Send_Key(edit, QEvent::KeyPress, Qt::Key_A, QStringLiteral("a"), true);
+        typed_text += QChar('a');
+        QCOMPARE(edit.toPlainText_Clean(), typed_text);
+    }
+    Send_Key(edit, QEvent::KeyRelease, Qt::Key_A, QStringLiteral("a"), false);
+
+    Send_Key(edit, QEvent::KeyPress, Qt::Key_Backspace, QStringLiteral("\b"), false);
+    for (int repeat_idx = 0; repeat_idx < 2; repeat_idx += 1)
+        Send_Key(edit, QEvent::KeyPress, Qt::Key_Backspace, QStringLiteral("\b"), true);
+    QCOMPARE(edit.toPlainText_Clean(), QStringLiteral("x = aa"));
+    Send_Key(edit, QEvent::KeyRelease, Qt::Key_Backspace, QStringLiteral("\b"), false);
+
+    Press_Standard_Key(edit, QKeySequence::Undo);
+    QCOMPARE(edit.toPlainText_Clean(), QStringLiteral("x = aaaaa"));
+    Press_Standard_Key(edit, QKeySequence::Undo);
+    QCOMPARE(edit.toPlainText_Clean(), QStringLiteral("x = "));
+}
+
+QTEST_MAIN(PlainTextEditTest)
+
+#include "PlainTextEditTest.moc"
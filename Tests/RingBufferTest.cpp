@@ -0,0 +1,137 @@
+/**************************************************************************
+**
+** Copyright (C) 2022 Ken Crossen, example expanded into useful application
+**
+** "Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are
+** met:
+**   * Redistributions of source code must retain the above copyright
+**     notice, this list of conditions and the following disclaimer.
+**   * Redistributions in binary form must reproduce the above copyright
+**     notice, this list of conditions and the following disclaimer in
+**     the documentation and/or other materials provided with the
+**     distribution.
+**   * Redistributions in source code or binary form may not be sold.
+**
+**************************************************************************/
+
+
+#include <QtTest>
+
+#include "RingBuffer.h"
+
+class RingBufferTest : public QObject {
+    Q_OBJECT
+
+private slots:
+    void Push_Pop ( );
+    void Evicts_Oldest_When_Full ( );
+    void Wraps_Around ( );
+    void Set_Capacity_Keeps_Newest ( );
+    void Clear ( );
+};
+
+void
+RingBufferTest::Push_Pop ( ) {
+    RingBuffer<int> ring(8);
+    QVERIFY(ring.isEmpty());
+
+    for (int item_idx = 0; item_idx < 5; item_idx += 1) ring.push(item_idx);
+    QCOMPARE(ring.count(), 5);
+    QCOMPARE(ring.first(), 0);
+    QCOMPARE(ring.top(), 4);
+    for (int item_idx = 0; item_idx < 5; item_idx += 1) QCOMPARE(ring.at(item_idx), item_idx);
+
+    QCOMPARE(ring.pop(), 4);
+    QCOMPARE(ring.pop(), 3);
+    QCOMPARE(ring.count(), 3);
+    QCOMPARE(ring.top(), 2);
+
+    ring.top() = 20;
+    ring[0] = 10;
+    QCOMPARE(ring.at(0), 10);
+    QCOMPARE(ring.at(2), 20);
+}
+
+void
+RingBufferTest::Evicts_Oldest_When_Full ( ) {
+    RingBuffer<int> ring(3);
+    for (int item_idx = 0; item_idx < 10; item_idx += 1) ring.push(item_idx);
+
+    QCOMPARE(ring.count(), 3);
+    QCOMPARE(ring.capacity(), 3);
+    QCOMPARE(ring.at(0), 7);
+    QCOMPARE(ring.at(1), 8);
+    QCOMPARE(ring.at(2), 9);
+}
+
+// Against a QList doing the same, past many wraps and reallocations
+void
+RingBufferTest::Wraps_Around ( ) {
+    RingBuffer<QString> ring(37);
+    QList<QString> expected;
+
+    quint32 seed = 12345;
+    for (int step_idx = 0; step_idx < 10000; step_idx += 1) {
+        seed = (seed * 1103515245) + 12345;
+        int choice = (seed >> 16) % 8;
+
+        if ((choice < 5) or expected.isEmpty()) {
+            QString item = QString::number(step_idx);
+            ring.push(item);
+            expected.append(item);
+            if (expected.count() > ring.capacity()) expected.removeFirst();
+        }
+        else if (choice < 7) QCOMPARE(ring.pop(), expected.takeLast());
+        else {
+            ring.removeFirst();
+            expected.removeFirst();
+        }
+
+        QCOMPARE(ring.count(), expected.count());
+        for (int item_idx = 0; item_idx < expected.count(); item_idx += 1)
+            QCOMPARE(ring.at(item_idx), expected.at(item_idx));
+    }
+}
+
+void
+RingBufferTest::Set_Capacity_Keeps_Newest ( ) {
+    RingBuffer<int> ring(10);
+    for (int item_idx = 0; item_idx < 10; item_idx += 1) ring.push(item_idx);
+
+    ring.setCapacity(4);
+    QCOMPARE(ring.count(), 4);
+    QCOMPARE(ring.first(), 6);
+    QCOMPARE(ring.top(), 9);
+
+    ring.setCapacity(6);
+    ring.push(10);
+    ring.push(11);
+    ring.push(12);
+    QCOMPARE(ring.count(), 6);
+    QCOMPARE(ring.first(), 7);
+    QCOMPARE(ring.top(), 12);
+
+    // Never less than one
+    ring.setCapacity(0);
+    QCOMPARE(ring.capacity(), 1);
+    QCOMPARE(ring.top(), 12);
+}
+
+void
+RingBufferTest::Clear ( ) {
+    RingBuffer<int> ring(5);
+    for (int item_idx = 0; item_idx < 7; item_idx += 1) ring.push(item_idx);
+
+    ring.clear();
+    QVERIFY(ring.isEmpty());
+
+    ring.push(42);
+    QCOMPARE(ring.count(), 1);
+    QCOMPARE(ring.first(), 42);
+    QCOMPARE(ring.top(), 42);
+}
+
+QTEST_APPLESS_MAIN(RingBufferTest)
+
+#include "RingBufferTest.moc"
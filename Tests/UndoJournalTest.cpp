@@ -0,0 +1,203 @@
+/**************************************************************************
+**
+** Copyright (C) 2022 Ken Crossen, example expanded into useful application
+**
+** "Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are
+** met:
+**   * Redistributions of source code must retain the above copyright
+**     notice, this list of conditions and the following disclaimer.
+**   * Redistributions in binary form must reproduce the above copyright
+**     notice, this list of conditions and the following disclaimer in
+**     the documentation and/or other materials provided with the
+**     distribution.
+**   * Redistributions in source code or binary form may not be sold.
+**
+**************************************************************************/
+
+
+#include <QtTest>
+#include <QtEndian>
+#include <QTemporaryDir>
+
+#include "UndoJournal.h"
+
+class UndoJournalTest : public QObject {
+    Q_OBJECT
+
+private slots:
+    void init ( );
+    void Append_Reopen ( );
+    void Torn_Record_Cut ( );
+    void Foreign_File_Refused ( );
+    void Rewrite ( );
+    void Clean_Header ( );
+
+private:
+    QTemporaryDir Journal_Dir;
+    QString Journal_Path;
+
+    static QByteArray Test_Record ( int Index );
+    static void Compare_Records ( const UndoJournal &Journal, const QVector<QByteArray> &Records );
+};
+
+void
+UndoJournalTest::init ( ) {
+    QVERIFY(Journal_Dir.isValid());
+    Journal_Path = Journal_Dir.filePath(QString::fromLatin1(QTest::currentTestFunction()) + QStringLiteral(".journal"));
+}
+
+// Lengths vary, some records are empty
+QByteArray
+UndoJournalTest::Test_Record ( int Index ) {
+    QByteArray record;
+    for (int byte_idx = 0; byte_idx < ((Index * 37) % 300); byte_idx += 1) record.append(char((Index + byte_idx) & 0xff));
+    return record;
+}
+
+void
+UndoJournalTest::Compare_Records ( const UndoJournal &Journal, const QVector<QByteArray> &Records ) {
+    QCOMPARE(Journal.Record_Count(), Records.count());
+    QCOMPARE(Journal.Journaled_Count(), Records.count());
+    for (int record_idx = 0; record_idx < Records.count(); record_idx += 1)
+        QCOMPARE(Journal.Record(record_idx), Records.at(record_idx));
+}
+
+void
+UndoJournalTest::Append_Reopen ( ) {
+    QVector<QByteArray> records;
+    UndoJournal journal;
+    QVERIFY(journal.Open(Journal_Path));
+    QCOMPARE(journal.Record_Count(), 0);
+
+    for (int record_idx = 0; record_idx < 100; record_idx += 1) {
+        records.append(Test_Record(record_idx));
+        journal.Append(records.last());
+    }
+    QCOMPARE(journal.Journaled_Count(), 100);
+    // Close drains the queue
+    journal.Close();
+    QVERIFY(not journal.Is_Open());
+
+    QVERIFY(journal.Open(Journal_Path));
+    Compare_Records(journal, records);
+
+    for (int record_idx = 100; record_idx < 150; record_idx += 1) {
+        records.append(Test_Record(record_idx));
+        journal.Append(records.last());
+    }
+    journal.Close();
+
+    QVERIFY(journal.Open(Journal_Path));
+    Compare_Records(journal, records);
+}
+
+// As if the writer had crashed mid-record
+void
+UndoJournalTest::Torn_Record_Cut ( ) {
+    QVector<QByteArray> records;
+    UndoJournal journal;
+    QVERIFY(journal.Open(Journal_Path));
+    for (int record_idx = 0; record_idx < 10; record_idx += 1) {
+        records.append(Test_Record(record_idx));
+        journal.Append(records.last());
+    }
+    journal.Close();
+
+    QFile torn_file(Journal_Path);
+    QVERIFY(torn_file.open(QIODevice::Append));
+    uchar torn_length[sizeof(quint32)];
+    qToLittleEndian<quint32>(1000, torn_length);
+    QByteArray torn_record(reinterpret_cast<const char*>(torn_length), sizeof(torn_length));
+    torn_record.append("only part of it");
+    torn_file.write(torn_record);
+    torn_file.close();
+    qint64 torn_size = torn_file.size();
+
+    // Opening alone leaves the file as it is
+    QVERIFY(journal.Open(Journal_Path));
+    Compare_Records(journal, records);
+    journal.Close();
+    QCOMPARE(torn_file.size(), torn_size);
+
+    QVERIFY(journal.Open(Journal_Path));
+    records.append(Test_Record(10));
+    journal.Append(records.last());
+    journal.Close();
+
+    QVERIFY(journal.Open(Journal_Path));
+    Compare_Records(journal, records);
+}
+
+void
+UndoJournalTest::Foreign_File_Refused ( ) {
+    QByteArray foreign_text("Not a journal, and not to be overwritten by one\n");
+    QFile foreign_file(Journal_Path);
+    QVERIFY(foreign_file.open(QIODevice::WriteOnly));
+    foreign_file.write(foreign_text);
+    foreign_file.close();
+
+    UndoJournal journal;
+    QVERIFY(not journal.Open(Journal_Path));
+    QVERIFY(not journal.Is_Open());
+
+    QVERIFY(foreign_file.open(QIODevice::ReadOnly));
+    QCOMPARE(foreign_file.readAll(), foreign_text);
+    foreign_file.close();
+
+    // An empty file is a journal not yet begun
+    QVERIFY(foreign_file.open(QIODevice::WriteOnly | QIODevice::Truncate));
+    foreign_file.close();
+    QVERIFY(journal.Open(Journal_Path));
+    QCOMPARE(journal.Record_Count(), 0);
+}
+
+void
+UndoJournalTest::Rewrite ( ) {
+    UndoJournal journal;
+    QVERIFY(journal.Open(Journal_Path));
+    for (int record_idx = 0; record_idx < 50; record_idx += 1) journal.Append(Test_Record(record_idx));
+    journal.Close();
+
+    QVERIFY(journal.Open(Journal_Path));
+    QCOMPARE(journal.Record_Count(), 50);
+
+    QVector<QByteArray> records = { Test_Record(7), Test_Record(8), Test_Record(9) };
+    journal.Rewrite(records);
+    QCOMPARE(journal.Journaled_Count(), 3);
+    records.append(Test_Record(60));
+    journal.Append(records.last());
+    journal.Close();
+
+    QVERIFY(journal.Open(Journal_Path));
+    Compare_Records(journal, records);
+}
+
+// Only a journal closed right after Mark_Clean knows its text
+void
+UndoJournalTest::Clean_Header ( ) {
+    QString journal_text = QStringLiteral("local angle; local sin4;");
+    UndoJournal journal;
+    QVERIFY(journal.Open(Journal_Path));
+    QVERIFY(not journal.Is_Clean());
+    journal.Append(Test_Record(0));
+    journal.Mark_Clean(journal_text);
+    journal.Close();
+
+    QVERIFY(journal.Open(Journal_Path));
+    QVERIFY(journal.Is_Clean());
+    QVERIFY(journal.Text_Matches(journal_text));
+    QVERIFY(not journal.Text_Matches(QStringLiteral("local angle; local sin5;")));
+    QVERIFY(not journal.Text_Matches(journal_text + QChar(' ')));
+    journal.Append(Test_Record(1));
+    journal.Close();
+
+    QVERIFY(journal.Open(Journal_Path));
+    QVERIFY(not journal.Is_Clean());
+    QVERIFY(not journal.Text_Matches(journal_text));
+    Compare_Records(journal, { Test_Record(0), Test_Record(1) });
+}
+
+QTEST_GUILESS_MAIN(UndoJournalTest)
+
+#include "UndoJournalTest.moc"
@@ -0,0 +1,272 @@
+/**************************************************************************
+**
+** Copyright (C) 2022 Ken Crossen, example expanded into useful application
+**
+** "Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are
+** met:
+**   * Redistributions of source code must retain the above copyright
+**     notice, this list of conditions and the following disclaimer.
+**   * Redistributions in binary form must reproduce the above copyright
+**     notice, this list of conditions and the following disclaimer in
+**     the documentation and/or other materials provided with the
+**     distribution.
+**   * Redistributions in source code or binary form may not be sold.
+**
+**************************************************************************/
+
+#include <algorithm>
+
+#include <QtTest>
+#include <QElapsedTimer>
+#include <QKeySequence>
+
+#include "PlainTextEdit.h"
+#include "UndoRedo.h"
+#include "UndoRedoManager.h"
+
+// Per-keystroke, Ctrl-Z/Ctrl-Y and jump latency and history memory ...
+// ... for documents from 1 KB to 10 MB. Keys go through QTest to a ...
+// ... PlainTextEdit shown on the offscreen platform ...
+// ... (QT_QPA_PLATFORM=offscreen, see "make benchmark"), so each ...
+// ... takes the whole path: keyPressEvent, UndoRedo, the document ...
+// ... change and digit grouping. QBENCHMARK gives the usual ...
+// ... per-iteration figure, each operation is also timed on its own ...
+// ... and reported as percentiles.
+class UndoRedoBenchmark : public QObject {
+    Q_OBJECT
+
+private slots:
+    void Keystroke_data ( );
+    void Keystroke ( );
+    void Undo_Redo_data ( );
+    void Undo_Redo ( );
+    void Jump_data ( );
+    void Jump ( );
+    void History_Memory_data ( );
+    void History_Memory ( );
+
+private:
+#define Benchmark_Typed_Text "local angle_2 = sin(angle_1) * 0.5; "
+#define Benchmark_Typed_Count 2000
+
+    static void Add_Document_Sizes ( );
+    static QString Document_Text ( int Length );
+    // Shown w/ Length chars of text, the cursor in the middle
+    static bool Open_Document ( PlainTextEdit &Edit, int Length );
+    static void Type_Keystrokes ( PlainTextEdit &Edit, int Count );
+    // The platform's first binding, e.g. Ctrl-Z for QKeySequence::Undo
+    static void Press_Standard_Key ( PlainTextEdit &Edit, QKeySequence::StandardKey Standard_Key );
+    // Undoes all the way back, redoes it all again
+    static int Count_Undo_Steps ( PlainTextEdit &Edit );
+    static void Report_Percentiles ( const char *Operation, QVector<qint64> &Nanoseconds );
+};
+
+void
+UndoRedoBenchmark::Add_Document_Sizes ( ) {
+    QTest::addColumn<int>("Document_Length");
+
+    QTest::newRow("1 KB") << 1024;
+    QTest::newRow("16 KB") << 16 * 1024;
+    QTest::newRow("256 KB") << 256 * 1024;
+    QTest::newRow("1 MB") << 1024 * 1024;
+    QTest::newRow("10 MB") << 10 * 1024 * 1024;
+}
+
+QString
+UndoRedoBenchmark::Document_Text ( int Length ) {
+    QString text;
+    text.reserve(Length + 64);
+    for (int line_idx = 0; text.length() < Length; line_idx += 1)
+        text += QStringLiteral("local value_%1 = sin(angle_%1 * 3.14159) + %2;\n").arg(line_idx).arg(line_idx % 97);
+    text.truncate(Length);
+    return text;
+}
+
+bool
+UndoRedoBenchmark::Open_Document ( PlainTextEdit &Edit, int Length ) {
+    Edit.Set_Numeric_Thin_Spaces(true);
+    Edit.setPlainText(Document_Text(Length));
+    Edit.show();
+    if (not QTest::qWaitForWindowExposed(&Edit)) return false;
+
+    QTextCursor middle_cursor(Edit.document());
+    middle_cursor.setPosition(Length / 2);
+    Edit.setTextCursor(middle_cursor);
+    return true;
+}
+
+void
+UndoRedoBenchmark::Type_Keystrokes ( PlainTextEdit &Edit, int Count ) {
+    static const QByteArray typed_text = QByteArrayLiteral(Benchmark_Typed_Text);
+    for (int typed_idx = 0; typed_idx < Count; typed_idx += 1)
+        QTest::keyClick(&Edit, typed_text.at(typed_idx % typed_text.length()));
+}
+
+void
+UndoRedoBenchmark::Press_Standard_Key ( PlainTextEdit &Edit, QKeySequence::StandardKey Standard_Key ) {
+    int key_combination = QKeySequence(Standard_Key)[0];
+    QTest::keyClick(&Edit, Qt::Key(key_combination & ~Qt::KeyboardModifierMask),
+                    Qt::KeyboardModifiers(key_combination & Qt::KeyboardModifierMask));
+}
+
+int
+UndoRedoBenchmark::Count_Undo_Steps ( PlainTextEdit &Edit ) {
+    int step_count = 0;
+    QString shown_text = Edit.toPlainText_Clean();
+    forever {
+        Press_Standard_Key(Edit, QKeySequence::Undo);
+        QString undone_text = Edit.toPlainText_Clean();
+        if (undone_text == shown_text) break;
+        shown_text = undone_text;
+        step_count += 1;
+    }
+    for (int step_idx = 0; step_idx < step_count; step_idx += 1)
+        Press_Standard_Key(Edit, QKeySequence::Redo);
+    return step_count;
+}
+
+void
+UndoRedoBenchmark::Report_Percentiles ( const char *Operation, QVector<qint64> &Nanoseconds ) {
+    if (Nanoseconds.isEmpty()) return;
+    std::sort(Nanoseconds.begin(), Nanoseconds.end());
+
+    auto percentile = [&] ( double Fraction ) {
+        return Nanoseconds.at(qMin(Nanoseconds.count() - 1, int(Fraction * Nanoseconds.count()))) / 1000.0;
+    };
+    qInfo("%s, %s: %d samples, p50 %.1f us, p90 %.1f us, p99 %.1f us, p99.9 %.1f us, max %.1f us",
+          QTest::currentDataTag(), Operation, Nanoseconds.count(),
+          percentile(0.5), percentile(0.9), percentile(0.99), percentile(0.999), Nanoseconds.last() / 1000.0);
+}
+
+void
+UndoRedoBenchmark::Keystroke_data ( ) {
+    Add_Document_Sizes();
+}
+
+// A key press and release, typed into the middle of the document
+void
+UndoRedoBenchmark::Keystroke ( ) {
+    QFETCH(int, Document_Length);
+
+    PlainTextEdit edit;
+    QVERIFY(Open_Document(edit, Document_Length));
+
+    static const QByteArray typed_text = QByteArrayLiteral(Benchmark_Typed_Text);
+    QVector<qint64> latencies;
+    QElapsedTimer keystroke_timer;
+    int typed_idx = 0;
+    QBENCHMARK {
+        char typed_ch = typed_text.at(typed_idx % typed_text.length());
+        typed_idx += 1;
+
+        keystroke_timer.start();
+        QTest::keyClick(&edit, typed_ch);
+        latencies.append(keystroke_timer.nsecsElapsed());
+    }
+    QVERIFY(edit.toPlainText_Clean().length() > Document_Length);
+    Report_Percentiles("keystroke", latencies);
+}
+
+void
+UndoRedoBenchmark::Undo_Redo_data ( ) {
+    Add_Document_Sizes();
+}
+
+// Ctrl-Z all the way back through what was typed, then Ctrl-Y
+void
+UndoRedoBenchmark::Undo_Redo ( ) {
+    QFETCH(int, Document_Length);
+
+    PlainTextEdit edit;
+    QVERIFY(Open_Document(edit, Document_Length));
+    Type_Keystrokes(edit, Benchmark_Typed_Count);
+    QString typed_text = edit.toPlainText_Clean();
+    int step_count = Count_Undo_Steps(edit);
+    QVERIFY(step_count > 0);
+    QCOMPARE(edit.toPlainText_Clean(), typed_text);
+
+    QVector<qint64> undo_latencies;
+    QVector<qint64> redo_latencies;
+    QElapsedTimer undo_redo_timer;
+    QBENCHMARK {
+        for (int step_idx = 0; step_idx < step_count; step_idx += 1) {
+            undo_redo_timer.start();
+            Press_Standard_Key(edit, QKeySequence::Undo);
+            undo_latencies.append(undo_redo_timer.nsecsElapsed());
+        }
+        for (int step_idx = 0; step_idx < step_count; step_idx += 1) {
+            undo_redo_timer.start();
+            Press_Standard_Key(edit, QKeySequence::Redo);
+            redo_latencies.append(undo_redo_timer.nsecsElapsed());
+        }
+    }
+    QCOMPARE(edit.toPlainText_Clean(), typed_text);
+    Report_Percentiles("undo", undo_latencies);
+    Report_Percentiles("redo", redo_latencies);
+}
+
+void
+UndoRedoBenchmark::Jump_data ( ) {
+    Add_Document_Sizes();
+}
+
+// From the newest state to the oldest and back, one restore each ...
+// ... (keyframes at their defaults), no key has a jump bound to it
+void
+UndoRedoBenchmark::Jump ( ) {
+    QFETCH(int, Document_Length);
+
+    PlainTextEdit edit;
+    QVERIFY(Open_Document(edit, Document_Length));
+    Type_Keystrokes(edit, Benchmark_Typed_Count);
+    QString typed_text = edit.toPlainText_Clean();
+    UndoRedo *history = UndoRedoManager::Shared()->History(&edit);
+    int history_length = history->History_Length();
+
+    QVector<qint64> jump_latencies;
+    QElapsedTimer jump_timer;
+    QBENCHMARK {
+        jump_timer.start();
+        history->Go_To_History_Index(0);
+        jump_latencies.append(jump_timer.nsecsElapsed());
+
+        jump_timer.start();
+        history->Go_To_History_Index(history_length);
+        jump_latencies.append(jump_timer.nsecsElapsed());
+    }
+    QCOMPARE(edit.toPlainText_Clean(), typed_text);
+    Report_Percentiles("jump", jump_latencies);
+}
+
+void
+UndoRedoBenchmark::History_Memory_data ( ) {
+    Add_Document_Sizes();
+}
+
+// What the undo capacity limits count (see Edit_Bytes), after ...
+// ... Benchmark_Typed_Count keystrokes and after undoing them all
+void
+UndoRedoBenchmark::History_Memory ( ) {
+    QFETCH(int, Document_Length);
+
+    PlainTextEdit edit;
+    QVERIFY(Open_Document(edit, Document_Length));
+    Type_Keystrokes(edit, Benchmark_Typed_Count);
+    int step_count = Count_Undo_Steps(edit);
+
+    // The widget's, served by the application's manager
+    UndoRedo *history = UndoRedoManager::Shared()->History(&edit);
+    qint64 typed_bytes = history->History_Bytes();
+    for (int step_idx = 0; step_idx < step_count; step_idx += 1)
+        Press_Standard_Key(edit, QKeySequence::Undo);
+    qint64 undone_bytes = history->History_Bytes();
+
+    qInfo("%s, history: %d undo steps, %lld bytes typed, %lld bytes undone",
+          QTest::currentDataTag(), step_count, typed_bytes, undone_bytes);
+    QTest::setBenchmarkResult(qMax(typed_bytes, undone_bytes), QTest::BytesAllocated);
+}
+
+QTEST_MAIN(UndoRedoBenchmark)
+
+#include "UndoRedoBenchmark.moc"
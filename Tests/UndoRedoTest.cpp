@@ -0,0 +1,351 @@
+/**************************************************************************
+**
+** Copyright (C) 2022 Ken Crossen, example expanded into useful application
+**
+** "Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are
+** met:
+**   * Redistributions of source code must retain the above copyright
+**     notice, this list of conditions and the following disclaimer.
+**   * Redistributions in binary form must reproduce the above copyright
+**     notice, this list of conditions and the following disclaimer in
+**     the documentation and/or other materials provided with the
+**     distribution.
+**   * Redistributions in source code or binary form may not be sold.
+**
+**************************************************************************/
+
+
+#include <QtTest>
+#include <QTemporaryDir>
+
+#include "UndoRedo.h"
+#include "UndoRedoManager.h"
+#include "PlainTextEdit.h"
+
+// A PlainTextEdit's own history, driven directly: the document is ...
+// ... changed through a cursor (not the widget's input handlers), ...
+// ... then the history pushes, undoes, redoes or jumps.
+class UndoRedoTest : public QObject {
+    Q_OBJECT
+
+private slots:
+    void Line_Diff_Round_Trip ( );
+    void Keyframe_Jumps_data ( );
+    void Keyframe_Jumps ( );
+    void Journal_Replay ( );
+    void Journal_Times ( );
+
+private:
+    quint32 Seed = 1;
+    int Random ( int Bound );
+    QString Random_Text ( int Length );
+
+    // Each test's widget gets a manager of its own
+    static UndoRedo *Widget_History ( UndoRedoManager &Manager, PlainTextEdit &Edit );
+    static void Replace_Text ( PlainTextEdit &Edit, int Position, int Remove_Count, const QString &Insert_Text );
+    // Inserts at least one character, so the edit is never null
+    void Random_Edit ( PlainTextEdit &Edit );
+    // Deletes, changes and inserts about Percent of the lines each
+    QString Mutate_Lines ( const QString &Text, int Percent );
+};
+
+int
+UndoRedoTest::Random ( int Bound ) {
+    Seed = (Seed * 1103515245) + 12345;
+    return int((Seed >> 8) % quint32(qMax(1, Bound)));
+}
+
+QString
+UndoRedoTest::Random_Text ( int Length ) {
+    QString text;
+    text.reserve(Length);
+    for (int ch_idx = 0; ch_idx < Length; ch_idx += 1)
+        text.append((Random(12) == 0) ? QChar('\n') : QChar('a' + Random(26)));
+    return text;
+}
+
+UndoRedo *
+UndoRedoTest::Widget_History ( UndoRedoManager &Manager, PlainTextEdit &Edit ) {
+    Edit.Set_Undo_Redo_Manager(&Manager);
+    return Manager.History(&Edit);
+}
+
+void
+UndoRedoTest::Replace_Text ( PlainTextEdit &Edit, int Position, int Remove_Count, const QString &Insert_Text ) {
+    QTextCursor edit_cursor(Edit.document());
+    edit_cursor.setPosition(Position);
+    edit_cursor.setPosition(Position + Remove_Count, QTextCursor::KeepAnchor);
+    edit_cursor.insertText(Insert_Text);
+    Edit.setTextCursor(edit_cursor);
+}
+
+void
+UndoRedoTest::Random_Edit ( PlainTextEdit &Edit ) {
+    int length = Edit.document()->characterCount() - 1;
+    int position = Random(length + 1);
+    int remove_count = Random(qMin(40, length - position) + 1);
+    Replace_Text(Edit, position, remove_count, Random_Text(Random(20) + 1));
+}
+
+QString
+UndoRedoTest::Mutate_Lines ( const QString &Text, int Percent ) {
+    QStringList lines = Text.split(QChar('\n'));
+    // The last "line" is what follows the last newline
+    QString last_line = lines.takeLast();
+
+    QStringList mutated_lines;
+    for (const QString &line : lines) {
+        int choice = Random(100);
+        if (choice < Percent) continue;
+        else if (choice < (2 * Percent)) mutated_lines.append(line + QStringLiteral(" // changed"));
+        else if (choice < (3 * Percent)) {
+            mutated_lines.append(line);
+            mutated_lines.append(QStringLiteral("local inserted_%1 = %2;").arg(Random(100000)).arg(Random(1000)));
+        }
+        else mutated_lines.append(line);
+    }
+    mutated_lines.append(last_line);
+    return mutated_lines.join(QChar('\n'));
+}
+
+// Whole document replacements keep their unchanged lines as pieces ...
+// ... of the text they replaced (Myers' diff in Insert_Pieces), ...
+// ... undo and redo must give back every text exactly. The last ...
+// ... rounds change too much for the diff and are copied instead.
+void
+UndoRedoTest::Line_Diff_Round_Trip ( ) {
+    Seed = 5;
+    QString text;
+    for (int line_idx = 0; line_idx < 3000; line_idx += 1)
+        text += QStringLiteral("local value_%1 = sin(angle_%1 * %2);\n").arg(line_idx).arg(Random(1000));
+
+    UndoRedoManager manager;
+    PlainTextEdit edit;
+    edit.setPlainText(text);
+    UndoRedo &history = *Widget_History(manager, edit);
+    history.Push_Undo();
+
+    QStringList states = { text };
+    for (int round_idx = 0; round_idx < 12; round_idx += 1) {
+        text = Mutate_Lines(text, (round_idx < 10) ? 1 : 30);
+        Replace_Text(edit, 0, edit.document()->characterCount() - 1, text);
+        history.Push_Undo();
+        QCOMPARE(edit.toPlainText(), text);
+        states.append(text);
+    }
+
+    for (int state_idx = states.count() - 2; state_idx >= 0; state_idx -= 1) {
+        history.Execute_Undo();
+        QCOMPARE(edit.toPlainText(), states.at(state_idx));
+    }
+    for (int state_idx = 1; state_idx < states.count(); state_idx += 1) {
+        history.Execute_Redo();
+        QCOMPARE(edit.toPlainText(), states.at(state_idx));
+    }
+    QCOMPARE(history.History_Index(), states.count() - 1);
+}
+
+void
+UndoRedoTest::Keyframe_Jumps_data ( ) {
+    QTest::addColumn<int>("Keyframe_Edit_Count");
+    QTest::addColumn<qint64>("Keyframe_Change_Bytes");
+
+    QTest::newRow("no keyframes") << 0 << qint64(0);
+    QTest::newRow("every 4 edits") << 4 << qint64(0);
+    QTest::newRow("every 2 KB") << 0 << qint64(2048);
+    QTest::newRow("default") << Default_Keyframe_Edit_Count << qint64(Default_Keyframe_Change_Bytes);
+}
+
+// Jumps anywhere along the path, then from a state in the middle ...
+// ... a new branch, which must not be reached through old keyframes
+void
+UndoRedoTest::Keyframe_Jumps ( ) {
+    QFETCH(int, Keyframe_Edit_Count);
+    QFETCH(qint64, Keyframe_Change_Bytes);
+
+    Seed = 6;
+    UndoRedoManager manager;
+    PlainTextEdit edit;
+    edit.setPlainText(Random_Text(20000));
+    UndoRedo &history = *Widget_History(manager, edit);
+    history.Set_Keyframe_Interval(Keyframe_Edit_Count, Keyframe_Change_Bytes);
+    history.Push_Undo();
+
+    QStringList states = { edit.toPlainText() };
+    for (int edit_idx = 0; edit_idx < 200; edit_idx += 1) {
+        Random_Edit(edit);
+        history.Push_Undo();
+        states.append(edit.toPlainText());
+    }
+    QCOMPARE(history.History_Length(), states.count() - 1);
+
+    for (int jump_idx = 0; jump_idx < 300; jump_idx += 1) {
+        int state_idx = Random(states.count());
+        QVERIFY(history.Go_To_History_Index(state_idx));
+        QCOMPARE(history.History_Index(), state_idx);
+        QCOMPARE(edit.toPlainText(), states.at(state_idx));
+
+        if ((jump_idx % 100) == 99) {
+            states = states.mid(0, state_idx + 1);
+            for (int edit_idx = 0; edit_idx < 50; edit_idx += 1) {
+                Random_Edit(edit);
+                history.Push_Undo();
+                states.append(edit.toPlainText());
+            }
+            QCOMPARE(history.History_Length(), states.count() - 1);
+        }
+    }
+}
+
+// What one session journaled another rebuilds, given the same text
+void
+UndoRedoTest::Journal_Replay ( ) {
+    QTemporaryDir journal_dir;
+    QVERIFY(journal_dir.isValid());
+    QString journal_path = journal_dir.filePath(QStringLiteral("document.journal"));
+
+    Seed = 7;
+    QStringList states;
+    QString session_text;
+    {
+        UndoRedoManager manager;
+        PlainTextEdit edit;
+        edit.setPlainText(Random_Text(5000));
+        UndoRedo &history = *Widget_History(manager, edit);
+        QVERIFY(history.Open_Journal(journal_path));
+
+        states.append(edit.toPlainText());
+        for (int edit_idx = 0; edit_idx < 30; edit_idx += 1) {
+            Random_Edit(edit);
+            history.Push_Undo();
+            states.append(edit.toPlainText());
+        }
+        for (int undo_idx = 0; undo_idx < 5; undo_idx += 1) history.Execute_Undo();
+        QCOMPARE(edit.toPlainText(), states.at(25));
+
+        session_text = edit.toPlainText();
+        history.Close_Journal();
+    }
+
+    {
+        UndoRedoManager manager;
+        PlainTextEdit edit;
+        edit.setPlainText(session_text);
+        UndoRedo &history = *Widget_History(manager, edit);
+        QVERIFY(history.Open_Journal(journal_path));
+        QCOMPARE(history.History_Index(), 25);
+        QCOMPARE(history.History_Length(), 30);
+        QCOMPARE(history.Redo_Stack_Count(), 5);
+
+        for (int state_idx = 24; state_idx >= 0; state_idx -= 1) {
+            history.Execute_Undo();
+            QCOMPARE(edit.toPlainText(), states.at(state_idx));
+        }
+        for (int state_idx = 1; state_idx < states.count(); state_idx += 1) {
+            history.Execute_Redo();
+            QCOMPARE(edit.toPlainText(), states.at(state_idx));
+        }
+        history.Close_Journal();
+    }
+
+    QFile journal_file(journal_path);
+    QVERIFY(journal_file.open(QIODevice::ReadOnly));
+    QByteArray journal_bytes = journal_file.readAll();
+    journal_file.close();
+
+    // Some other text of the same length is refused, the history ...
+    // ... and the journal are left as they are
+    {
+        UndoRedoManager manager;
+        PlainTextEdit edit;
+        edit.setPlainText(QString(states.last().length() - 1, QChar('#')));
+        UndoRedo &history = *Widget_History(manager, edit);
+        history.Push_Undo();
+        Replace_Text(edit, 0, 0, QStringLiteral("#"));
+        history.Push_Undo();
+        QVERIFY(not history.Open_Journal(journal_path));
+        QCOMPARE(history.History_Length(), 1);
+        QCOMPARE(edit.toPlainText(), QString(states.last().length(), QChar('#')));
+    }
+    QVERIFY(journal_file.open(QIODevice::ReadOnly));
+    QCOMPARE(journal_file.readAll(), journal_bytes);
+    journal_file.close();
+
+    // One more edit, then gone w/o Close_Journal (as if crashed), ...
+    // ... the text is then checked against the top undo edit
+    {
+        UndoRedoManager manager;
+        PlainTextEdit edit;
+        edit.setPlainText(states.last());
+        UndoRedo &history = *Widget_History(manager, edit);
+        QVERIFY(history.Open_Journal(journal_path));
+        QCOMPARE(history.History_Index(), 30);
+        Random_Edit(edit);
+        history.Push_Undo();
+        states.append(edit.toPlainText());
+    }
+    {
+        UndoRedoManager manager;
+        PlainTextEdit edit;
+        edit.setPlainText(states.at(30));
+        UndoRedo &history = *Widget_History(manager, edit);
+        QVERIFY(not history.Open_Journal(journal_path));
+        QCOMPARE(history.History_Length(), 0);
+
+        edit.setPlainText(states.last());
+        QVERIFY(history.Open_Journal(journal_path));
+        QCOMPARE(history.History_Index(), 31);
+        history.Execute_Undo();
+        QCOMPARE(edit.toPlainText(), states.at(30));
+        history.Close_Journal();
+    }
+}
+
+// Edit times and serials come back w/ the edits
+void
+UndoRedoTest::Journal_Times ( ) {
+    QTemporaryDir journal_dir;
+    QVERIFY(journal_dir.isValid());
+    QString journal_path = journal_dir.filePath(QStringLiteral("document.journal"));
+
+    Seed = 8;
+    QVector<qint64> edit_times;
+    quint64 undo_order;
+    QString session_text;
+    {
+        UndoRedoManager manager;
+        PlainTextEdit edit;
+        edit.setPlainText(Random_Text(1000));
+        UndoRedo &history = *Widget_History(manager, edit);
+        QVERIFY(history.Open_Journal(journal_path));
+        for (int edit_idx = 0; edit_idx < 3; edit_idx += 1) {
+            QTest::qSleep(20);
+            Random_Edit(edit);
+            history.Push_Undo();
+            edit_times.append(QDateTime::currentMSecsSinceEpoch());
+        }
+        undo_order = history.Undo_Order();
+        session_text = edit.toPlainText();
+        history.Close_Journal();
+    }
+
+    UndoRedoManager manager;
+    PlainTextEdit edit;
+    edit.setPlainText(session_text);
+    UndoRedo &history = *Widget_History(manager, edit);
+    QVERIFY(history.Open_Journal(journal_path));
+    QCOMPARE(history.History_Index_At(edit_times.first() - 40), 0);
+    for (int edit_idx = 0; edit_idx < edit_times.count(); edit_idx += 1)
+        QCOMPARE(history.History_Index_At(edit_times.at(edit_idx)), edit_idx + 1);
+    QCOMPARE(history.Undo_Order(), undo_order);
+
+    Random_Edit(edit);
+    history.Push_Undo();
+    QVERIFY(history.Undo_Order() > undo_order);
+    history.Close_Journal();
+}
+
+QTEST_MAIN(UndoRedoTest)
+
+#include "UndoRedoTest.moc"
@@ -0,0 +1,349 @@
+/**************************************************************************
+**
+** Copyright (C) 2022 Ken Crossen, example expanded into useful application
+**
+** "Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are
+** met:
+**   * Redistributions of source code must retain the above copyright
+**     notice, this list of conditions and the following disclaimer.
+**   * Redistributions in binary form must reproduce the above copyright
+**     notice, this list of conditions and the following disclaimer in
+**     the documentation and/or other materials provided with the
+**     distribution.
+**   * Redistributions in source code or binary form may not be sold.
+**
+**************************************************************************/
+
+
+#include <cstring>
+
+#include <QCryptographicHash>
+#include <QMutexLocker>
+#include <QtEndian>
+
+#if defined(Q_OS_WIN)
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "UndoJournal.h"
+
+static const char Journal_Magic[4] = { 'U', 'R', 'J', '2' };
+static const int Journal_Hash_Size = 20;
+static const qint64 Journal_Header_Size = sizeof(Journal_Magic) + sizeof(quint32) + sizeof(quint64) + Journal_Hash_Size;
+
+UndoJournal::UndoJournal ( ) {
+    Queue_Head.storeRelease(&Queue_Stub);
+    Queue_Tail = &Queue_Stub;
+}
+
+UndoJournal::~UndoJournal ( ) {
+    Close();
+}
+
+bool
+UndoJournal::Open ( const QString &Journal_Path ) {
+    Close();
+
+    Write_File.setFileName(Journal_Path);
+    if (not Write_File.open(QIODevice::ReadWrite)) return false;
+
+    // Some other file is refused, a new journal (or one torn before ...
+    // ... its header was down) gets a header w/ the first record
+    qint64 file_size = Write_File.size();
+    QByteArray file_header = Write_File.read(Journal_Header_Size);
+    if (not QByteArray::fromRawData(Journal_Magic, sizeof(Journal_Magic)).startsWith(file_header.left(sizeof(Journal_Magic)))) {
+        Write_File.close();
+        return false;
+    }
+    bool has_header = (file_header.size() == Journal_Header_Size);
+    const uchar *header_data = reinterpret_cast<const uchar*>(file_header.constData());
+    Header_Clean = has_header and (qFromLittleEndian<quint32>(header_data + sizeof(Journal_Magic)) == 1);
+    Header_Text_Length = Header_Clean ? qint64(qFromLittleEndian<quint64>(header_data + sizeof(Journal_Magic) + sizeof(quint32))) : 0;
+    Header_Text_Hash = Header_Clean ? file_header.right(Journal_Hash_Size) : QByteArray();
+
+    // Locate existing records, a torn record at the end (crash ...
+    // ... mid-write) is left out and cut off by the first write
+    qint64 record_offset = Journal_Header_Size;
+    if (has_header and (file_size > Journal_Header_Size)) {
+        Map_File.setFileName(Journal_Path);
+        if (Map_File.open(QIODevice::ReadOnly))
+            Map_Data = Map_File.map(0, file_size);
+        if (Map_Data == nullptr) {
+            Map_File.close();
+            Write_File.close();
+            return false;
+        }
+        while ((record_offset + qint64(sizeof(quint32))) <= file_size) {
+            qint64 record_length = qFromLittleEndian<quint32>(Map_Data + record_offset);
+            if ((record_offset + qint64(sizeof(quint32)) + record_length) > file_size) break;
+            Record_Offsets.append(record_offset);
+            record_offset += sizeof(quint32) + record_length;
+        }
+    }
+    Write_Offset = has_header ? record_offset : 0;
+    Header_Dirty = has_header and (not Header_Clean);
+
+    Appended_Count = 0;
+    Queued_Signals.storeRelease(0);
+    Writer = new Journal_Writer(this);
+    Writer->start(QThread::LowPriority);
+
+    return true;
+}
+
+void
+UndoJournal::Close ( ) {
+    if (not (Writer == nullptr)) {
+        // The writer drains the queue once more before it stops
+        Writer->Stop_Requested.storeRelease(1);
+        {
+            QMutexLocker wake_locker(&Wake_Mutex);
+            Wake_Condition.wakeAll();
+        }
+        Writer->wait();
+        delete Writer;
+        Writer = nullptr;
+    }
+
+    if (not (Map_Data == nullptr)) Map_File.unmap(const_cast<uchar*>(Map_Data));
+    Map_Data = nullptr;
+    Map_File.close();
+    Record_Offsets.clear();
+
+    Write_File.close();
+}
+
+bool
+UndoJournal::Is_Open ( ) const {
+    return (not (Writer == nullptr));
+}
+
+void
+UndoJournal::Append ( const QByteArray &Record ) {
+    if (Writer == nullptr) return;
+
+    Queue_Node *record_node = new Queue_Node;
+    record_node->Record = Record;
+    Enqueue(record_node);
+    Appended_Count += 1;
+    Signal_Writer();
+}
+
+void
+UndoJournal::Rewrite ( const QVector<QByteArray> &Records ) {
+    if (Writer == nullptr) return;
+
+    // The writer cuts the file while nothing maps it
+    if (not (Map_Data == nullptr)) Map_File.unmap(const_cast<uchar*>(Map_Data));
+    Map_Data = nullptr;
+    Map_File.close();
+    Record_Offsets.clear();
+
+    Queue_Node *truncate_node = new Queue_Node;
+    truncate_node->Truncate = true;
+    Enqueue(truncate_node);
+    Appended_Count = 0;
+    for (const QByteArray &record : Records) {
+        Queue_Node *record_node = new Queue_Node;
+        record_node->Record = record;
+        Enqueue(record_node);
+        Appended_Count += 1;
+    }
+    Signal_Writer();
+}
+
+void
+UndoJournal::Mark_Clean ( const QString &Text ) {
+    if (Writer == nullptr) return;
+
+    Queue_Node *header_node = new Queue_Node;
+    header_node->Clean_Header = true;
+    header_node->Text_Length = Text.length();
+    header_node->Record = Text_Hash(Text);
+    Enqueue(header_node);
+    Signal_Writer();
+}
+
+bool
+UndoJournal::Is_Clean ( ) const {
+    return Header_Clean;
+}
+
+bool
+UndoJournal::Text_Matches ( const QString &Text ) const {
+    return Header_Clean and (Text.length() == Header_Text_Length) and (Text_Hash(Text) == Header_Text_Hash);
+}
+
+QByteArray
+UndoJournal::Text_Hash ( const QString &Text ) {
+    return QCryptographicHash::hash(QByteArray::fromRawData(reinterpret_cast<const char*>(Text.constData()),
+                                                            Text.length() * int(sizeof(QChar))),
+                                    QCryptographicHash::Sha1);
+}
+
+int
+UndoJournal::Record_Count ( ) const {
+    return Record_Offsets.count();
+}
+
+int
+UndoJournal::Journaled_Count ( ) const {
+    return Record_Offsets.count() + Appended_Count;
+}
+
+// Points into the mapping, valid until the journal is closed
+QByteArray
+UndoJournal::Record ( int Index ) const {
+    const uchar *record_data = Map_Data + Record_Offsets.at(Index);
+    return QByteArray::fromRawData(reinterpret_cast<const char*>(record_data + sizeof(quint32)),
+                                   int(qFromLittleEndian<quint32>(record_data)));
+}
+
+void
+UndoJournal::Enqueue ( Queue_Node *Node ) {
+    Node->Next.storeRelease(nullptr);
+    Queue_Node *previous_node = Queue_Head.fetchAndStoreOrdered(Node);
+    previous_node->Next.storeRelease(Node);
+}
+
+// Writer thread only, nullptr when nothing is (completely) queued yet
+UndoJournal::Queue_Node *
+UndoJournal::Dequeue ( ) {
+    Queue_Node *tail_node = Queue_Tail;
+    Queue_Node *next_node = tail_node->Next.loadAcquire();
+
+    if (tail_node == &Queue_Stub) {
+        if (next_node == nullptr) return nullptr;
+        Queue_Tail = next_node;
+        tail_node = next_node;
+        next_node = next_node->Next.loadAcquire();
+    }
+    if (not (next_node == nullptr)) {
+        Queue_Tail = next_node;
+        return tail_node;
+    }
+    // A producer is between swapping the head and linking its node
+    if (not (tail_node == Queue_Head.loadAcquire())) return nullptr;
+
+    Enqueue(&Queue_Stub);
+    next_node = tail_node->Next.loadAcquire();
+    if (not (next_node == nullptr)) {
+        Queue_Tail = next_node;
+        return tail_node;
+    }
+    return nullptr;
+}
+
+// Writer thread only, also cuts off whatever follows Write_Offset
+void
+UndoJournal::Write_Header ( bool Clean, qint64 Text_Length, const QByteArray &Hash ) {
+    uchar header_data[Journal_Header_Size] = { };
+    memcpy(header_data, Journal_Magic, sizeof(Journal_Magic));
+    qToLittleEndian<quint32>(Clean ? 1 : 0, header_data + sizeof(Journal_Magic));
+    qToLittleEndian<quint64>(quint64(Text_Length), header_data + sizeof(Journal_Magic) + sizeof(quint32));
+    memcpy(header_data + Journal_Header_Size - Journal_Hash_Size, Hash.constData(), qMin(Hash.size(), Journal_Hash_Size));
+
+    Write_File.seek(0);
+    Write_File.write(reinterpret_cast<const char*>(header_data), sizeof(header_data));
+    Write_Offset = qMax(Write_Offset, Journal_Header_Size);
+    Write_File.flush();
+    Write_File.resize(Write_Offset);
+    Write_File.seek(Write_Offset);
+    Header_Dirty = (not Clean);
+}
+
+void
+UndoJournal::Sync_File ( ) {
+    Write_File.flush();
+#if defined(Q_OS_WIN)
+    _commit(Write_File.handle());
+#else
+    fsync(Write_File.handle());
+#endif
+}
+
+// Writes whatever is queued, fsyncs once for the whole batch (and ...
+// ... once before it, so no record is ever down under a clean header)
+bool
+UndoJournal::Write_Pending ( ) {
+    bool wrote_records = false;
+
+    Queue_Node *record_node;
+    while (not ((record_node = Dequeue()) == nullptr)) {
+        if (record_node->Clean_Header) {
+            Sync_File();
+            Write_Header(true, record_node->Text_Length, record_node->Record);
+            delete record_node;
+            wrote_records = true;
+            continue;
+        }
+
+        if (not Header_Dirty) {
+            Write_Header(false, 0, QByteArray());
+            Sync_File();
+        }
+
+        if (record_node->Truncate) {
+            Write_File.flush();
+            Write_Offset = Journal_Header_Size;
+            Write_File.resize(Write_Offset);
+            Write_File.seek(Write_Offset);
+            delete record_node;
+            wrote_records = true;
+            continue;
+        }
+
+        uchar length_bytes[sizeof(quint32)];
+        qToLittleEndian<quint32>(quint32(record_node->Record.size()), length_bytes);
+        Write_File.write(reinterpret_cast<const char*>(length_bytes), sizeof(length_bytes));
+        Write_File.write(record_node->Record);
+        Write_Offset += sizeof(length_bytes) + record_node->Record.size();
+        delete record_node;
+        wrote_records = true;
+    }
+
+    if (wrote_records) Sync_File();
+
+    return wrote_records;
+}
+
+// Wakes the writer if it is asleep, the mutex is only taken then
+void
+UndoJournal::Signal_Writer ( ) {
+    if (Queued_Signals.fetchAndAddOrdered(1) == -1) {
+        QMutexLocker wake_locker(&Wake_Mutex);
+        Wake_Condition.wakeOne();
+    }
+}
+
+// Writer thread only, sleeps until a record is queued (or Close), ...
+// ... then lets a burst gather so one fsync covers it
+void
+UndoJournal::Wait_For_Records ( ) {
+    QMutexLocker wake_locker(&Wake_Mutex);
+
+    // Holding the mutex until the wait, a signal after the swap to ...
+    // ... -1 can't be lost, one before it makes the swap fail
+    if (Queued_Signals.testAndSetOrdered(0, -1)) {
+        while ((Queued_Signals.loadAcquire() == -1) and (Writer->Stop_Requested.loadAcquire() == 0))
+            Wake_Condition.wait(&Wake_Mutex);
+    }
+
+    if (Writer->Stop_Requested.loadAcquire() == 0)
+        Wake_Condition.wait(&Wake_Mutex, Journal_Flush_Milliseconds);
+}
+
+void
+UndoJournal::Journal_Writer::run ( ) {
+    forever {
+        Journal->Wait_For_Records();
+        bool stopping = (Stop_Requested.loadAcquire() == 1);
+        // Records signalled from here on are left for the next drain
+        Journal->Queued_Signals.fetchAndStoreOrdered(0);
+        Journal->Write_Pending();
+        if (stopping) break;
+    }
+}
@@ -0,0 +1,137 @@
+/**************************************************************************
+**
+** Copyright (C) 2022 Ken Crossen, example expanded into useful application
+**
+** "Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are
+** met:
+**   * Redistributions of source code must retain the above copyright
+**     notice, this list of conditions and the following disclaimer.
+**   * Redistributions in binary form must reproduce the above copyright
+**     notice, this list of conditions and the following disclaimer in
+**     the documentation and/or other materials provided with the
+**     distribution.
+**   * Redistributions in source code or binary form may not be sold.
+**
+**************************************************************************/
+
+
+#ifndef UNDOJOURNAL_H
+#define UNDOJOURNAL_H
+
+#include <QAtomicInt>
+#include <QAtomicPointer>
+#include <QByteArray>
+#include <QFile>
+#include <QMutex>
+#include <QThread>
+#include <QVector>
+#include <QWaitCondition>
+
+// Append-only journal of undo history records, one file per document.
+// Append never locks, records go onto a lock-free queue that a ...
+// ... writer thread drains, writes and fsyncs once per interval.
+// The writer sleeps on a wait condition while nothing is queued, ...
+// ... Append only wakes it (under the mutex) when it is asleep.
+// Records already in the file when it is opened are memory mapped ...
+// ... and only located, each is read when Record asks for it.
+// File layout: header, then records as [quint32 length][payload]. ...
+// ... The header is magic, a clean flag and the length and SHA-1 of ...
+// ... the text the history ends at, rewritten clean by Mark_Clean ...
+// ... and dirty (w/o the text) before the first record after that.
+class UndoJournal {
+public:
+    UndoJournal ( );
+    ~UndoJournal ( );
+
+    // A file that is not a journal is refused, never overwritten. ...
+    // ... Nothing is written to the file (not even a torn record at ...
+    // ... the end cut off) until the first record is.
+    bool Open ( const QString &Journal_Path );
+    void Close ( );
+    bool Is_Open ( ) const;
+
+    void Append ( const QByteArray &Record );
+    // Replaces everything journaled so far w/ Records (e.g. the ...
+    // ... records that rebuild the stacks as they are now), ...
+    // ... records located at Open can no longer be read.
+    void Rewrite ( const QVector<QByteArray> &Records );
+
+    // Records located when the journal was opened
+    int Record_Count ( ) const;
+    QByteArray Record ( int Index ) const;
+    // Records the file holds (or will) counting those appended since
+    int Journaled_Count ( ) const;
+
+    // The text the history ends at once everything queued is written
+    void Mark_Clean ( const QString &Text );
+    // As the header was when the journal was opened: the text is ...
+    // ... only known if the last session marked it clean.
+    bool Is_Clean ( ) const;
+    bool Text_Matches ( const QString &Text ) const;
+
+private:
+    struct Queue_Node {
+        QByteArray Record;
+        // Cut the file back to its header before writing what follows
+        bool Truncate = false;
+        // Record is the hash of a Text_Length text, see Mark_Clean
+        bool Clean_Header = false;
+        qint64 Text_Length = 0;
+        QAtomicPointer<Queue_Node> Next;
+    };
+
+    // Multiple producer, single consumer queue (Vyukov), the stub ...
+    // ... node keeps it from ever being truly empty.
+    Queue_Node Queue_Stub;
+    QAtomicPointer<Queue_Node> Queue_Head;
+    Queue_Node *Queue_Tail;
+
+    void Enqueue ( Queue_Node *Node );
+    Queue_Node *Dequeue ( );
+
+    // Records enqueued since the writer last drained the queue, ...
+    // ... -1 while the writer is asleep waiting for one.
+    QAtomicInt Queued_Signals;
+    QMutex Wake_Mutex;
+    QWaitCondition Wake_Condition;
+
+    void Signal_Writer ( );
+    void Wait_For_Records ( );
+
+    class Journal_Writer : public QThread {
+    public:
+        explicit Journal_Writer ( UndoJournal *New_Journal ) : Journal(New_Journal) { }
+        QAtomicInt Stop_Requested;
+    protected:
+        void run ( ) override;
+    private:
+        UndoJournal *Journal;
+    };
+
+    Journal_Writer *Writer = nullptr;
+    QFile Write_File;
+
+    QFile Map_File;
+    const uchar *Map_Data = nullptr;
+    QVector<qint64> Record_Offsets;
+    int Appended_Count = 0;
+
+    bool Header_Clean = false;
+    qint64 Header_Text_Length = 0;
+    QByteArray Header_Text_Hash;
+
+    // Writer thread only: where the next record goes and whether ...
+    // ... the file's header says dirty yet
+    qint64 Write_Offset = 0;
+    bool Header_Dirty = false;
+
+    static QByteArray Text_Hash ( const QString &Text );
+    void Write_Header ( bool Clean, qint64 Text_Length, const QByteArray &Hash );
+    void Sync_File ( );
+    bool Write_Pending ( );
+
+#define Journal_Flush_Milliseconds 200
+};
+
+#endif // UNDOJOURNAL_H
@@ -16,6 +16,15 @@
 **************************************************************************/
 
 #include <QObject>
+#include <QDataStream>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QTextCodec>
+#include <QtConcurrent>
+#include <QScrollBar>
+#include <QTextCursor>
+#include <QTimerEvent>
 
 #include "UndoRedo.h"
 #include "LineEdit.h"
@@ -24,7 +33,11 @@
 extern
 uint Keyboard_Modifiers;
 
-UndoRedo::UndoRedo ( QObject *parent ) : QObject(parent) {
+UndoRedo::UndoRedo ( QObject *parent ) : QObject(parent),
+    Undo_Stack(Default_Maximum_Undo_Stack_Count),
+    Redo_Stack(Default_Maximum_Undo_Stack_Count + 1) {
+    Do_State.reserve(Do_State_Reserve_Length);
+
     // This supports less aggressive undo/redo command compression.
     // Normally any adjacent insert operations are treated as a single ...
     // ... undoable/redoable operation. When inserts are being made in ...
@@ -52,27 +65,129 @@ UndoRedo::UndoRedo ( QObject *parent ) : QObject(parent) {
     // ... as a separate undo/redo unit.
 }
 
+UndoRedo::~UndoRedo ( ) {
+    delete Journal;
+}
+
 void
 UndoRedo::Set_Focus_Widget ( QWidget *New_Focus_Widget ) {
+    Finish_Restore();
+    if (not (Focus_LineEdit == nullptr))
+        disconnect(Focus_LineEdit, SIGNAL(textChanged(QString)), this, SLOT(Document_Changed()));
+    else if (not (Focus_PlainTextEdit == nullptr))
+        disconnect(Focus_PlainTextEdit->document(), SIGNAL(contentsChange(int,int,int)),
+                   this, SLOT(Document_Contents_Change(int,int,int)));
+
     Focus_Widget = New_Focus_Widget;
 
     Focus_LineEdit = qobject_cast<LineEdit*>(Focus_Widget);
     Focus_PlainTextEdit = qobject_cast<PlainTextEdit*>(Focus_Widget);
+
+    if (not (Focus_LineEdit == nullptr))
+        connect(Focus_LineEdit, SIGNAL(textChanged(QString)), this, SLOT(Document_Changed()));
+    else if (not (Focus_PlainTextEdit == nullptr))
+        connect(Focus_PlainTextEdit->document(), SIGNAL(contentsChange(int,int,int)),
+                this, SLOT(Document_Contents_Change(int,int,int)));
+    Document_Changed();
+
+    // Edits are now applied to the document rather than replacing it, ...
+    // ... so its own undo stack would keep a second copy of every one
+    if (not (Focus_PlainTextEdit == nullptr)) Focus_PlainTextEdit->setUndoRedoEnabled(false);
+}
+
+void
+UndoRedo::Document_Changed ( ) {
+    Document_Generation += 1;
+    Changed_Serial = Next_Serial();
+    Changed_Begin = 0;
+    Changed_Tail = 0;
+}
+
+void
+UndoRedo::Document_Contents_Change ( int Position, int Chars_Removed, int Chars_Added ) {
+    Q_UNUSED(Chars_Removed);
+
+    // Unchanged text after the change, the same in the document now ...
+    // ... and in the document as it was
+    int document_length = Focus_PlainTextEdit->document()->characterCount() - 1;
+    int tail_length = qMax(0, document_length - Position - Chars_Added);
+
+    if (Document_Generation == History_Generation) {
+        Changed_Begin = Position;
+        Changed_Tail = tail_length;
+    }
+    else {
+        Changed_Begin = qMin(Changed_Begin, Position);
+        Changed_Tail = qMin(Changed_Tail, tail_length);
+    }
+    Document_Generation += 1;
+    Changed_Serial = Next_Serial();
+}
+
+// Same characters toPlainText() would produce, from Position on
+static void
+Plain_Text_Fixups ( QString &Text, int Position ) {
+    QChar *text_data = Text.data();
+    for (int ch_idx = Position; ch_idx < Text.length(); ch_idx += 1) {
+        QChar text_ch = text_data[ch_idx];
+        if ((text_ch == QChar::ParagraphSeparator) or (text_ch == QChar::LineSeparator))
+            text_data[ch_idx] = '\n';
+        else if (text_ch == QChar::Nbsp) text_data[ch_idx] = ' ';
+    }
+}
+
+// "\r\n" and a lone '\r' end a line as '\n' does, ...
+// ... Ended_In_Return carries a '\r' over to the next chunk.
+static void
+Normalize_Line_Ends ( QString &Text, bool &Ended_In_Return ) {
+    QChar *text_data = Text.data();
+    int write_idx = 0;
+    for (int read_idx = 0; read_idx < Text.length(); read_idx += 1) {
+        QChar text_ch = text_data[read_idx];
+        if ((text_ch == QChar('\n')) and Ended_In_Return) {
+            Ended_In_Return = false;
+            continue;
+        }
+        Ended_In_Return = (text_ch == QChar('\r'));
+        text_data[write_idx] = Ended_In_Return ? QChar('\n') : text_ch;
+        write_idx += 1;
+    }
+    Text.truncate(write_idx);
 }
 
 // These must be "native" to this widget ...
-UndoRedo::Text_State
-UndoRedo::Save_Text_State ( ) {
-    Text_State current_state;
+QString
+UndoRedo::Current_Text ( ) {
+    if (not (Focus_LineEdit == nullptr)) return Focus_LineEdit->text();
+    else if (not (Focus_PlainTextEdit == nullptr)) return Focus_PlainTextEdit->toPlainText_Clean();
+    return QString();
+}
+
+QString
+UndoRedo::Current_Text ( int Position, int Count ) {
+    if (not (Focus_LineEdit == nullptr)) return Focus_LineEdit->text().mid(Position, Count);
+    else if (not (Focus_PlainTextEdit == nullptr)) {
+        QTextCursor slice_cursor(Focus_PlainTextEdit->document());
+        slice_cursor.setPosition(Position, QTextCursor::MoveAnchor);
+        slice_cursor.setPosition(Position + Count, QTextCursor::KeepAnchor);
+
+        QString slice_text = slice_cursor.selectedText();
+        Plain_Text_Fixups(slice_text, 0);
+        return slice_text;
+    }
+    return QString();
+}
+
+UndoRedo::Cursor_State
+UndoRedo::Save_Cursor_State ( ) {
+    Cursor_State current_state;
 
     if (not (Focus_LineEdit == nullptr)) {
-        current_state.Text = Focus_LineEdit->text();
         current_state.Select_Begin = Focus_LineEdit->selectionStart();
         current_state.Select_End = Focus_LineEdit->selectionEnd();
         current_state.Cursor_Position = Focus_LineEdit->cursorPosition();
     }
     else if (not (Focus_PlainTextEdit == nullptr)) {
-        current_state.Text = Focus_PlainTextEdit->toPlainText_Clean();
         current_state.Select_Begin = Focus_PlainTextEdit->textCursor().selectionStart();
         current_state.Select_End = Focus_PlainTextEdit->textCursor().selectionEnd();
         current_state.Cursor_Position = Focus_PlainTextEdit->textCursor().position();
@@ -81,18 +196,196 @@ UndoRedo::Save_Text_State ( ) {
     return current_state;
 }
 
+#if defined(UNDOREDO_METRICS)
+static void
+Count_Latency ( quint64 *Histogram, qint64 Nanoseconds ) {
+    qint64 microseconds = Nanoseconds / 1000;
+    int bucket = 0;
+    while ((microseconds > 0) and (bucket < (Metrics_Latency_Bucket_Count - 1))) {
+        microseconds >>= 1;
+        bucket += 1;
+    }
+    Histogram[bucket] += 1;
+}
+#endif
+
 void
-UndoRedo::Restore_Text_State ( Text_State New_Text_State ) {
+UndoRedo::Restore_Text_State ( int Position, int Remove_Count, const QString &Insert_Text,
+                               Cursor_State New_Cursor_State ) {
+#if defined(UNDOREDO_METRICS)
+    QElapsedTimer restore_timer;
+    restore_timer.start();
+#endif
+
+    // One restore at a time, a second one (e.g. pending text reverted, ...
+    // ... then an edit undone) waits for the first
+    if (Restore_Active) Complete_Restore();
+
+    if (Asynchronous_Restore and (not (Focus_PlainTextEdit == nullptr)) and
+        ((Remove_Count + Insert_Text.length()) > Asynchronous_Restore_Length)) {
+        Restore_Position = Position;
+        Restore_Remove_Count = Remove_Count;
+        Restore_Insert_Text = Insert_Text;
+        Restore_Insert_Offset = 0;
+        Restore_Cursor_State = New_Cursor_State;
+        Restore_Horizontal_Value = Focus_PlainTextEdit->horizontalScrollBar()->value();
+        Restore_Vertical_Value = Focus_PlainTextEdit->verticalScrollBar()->value();
+        Restore_Cursor = QTextCursor(Focus_PlainTextEdit->document());
+        Restore_Read_Only = Focus_PlainTextEdit->isReadOnly();
+        Focus_PlainTextEdit->setReadOnly(true);
+        Restore_Active = true;
+        Restore_Timer.start(0, this);
+        return;
+    }
+
+    // Cursor at one end of the selection, anchor at the other
+    int anchor_position = New_Cursor_State.Select_Begin;
+    if (New_Cursor_State.Cursor_Position == New_Cursor_State.Select_Begin)
+        anchor_position = New_Cursor_State.Select_End;
+
     if (not (Focus_LineEdit == nullptr)) {
-        Focus_LineEdit->setText(New_Text_State.Text);
-        Focus_LineEdit->setCursorPosition(New_Text_State.Cursor_Position);
+        QString new_text = Focus_LineEdit->text();
+        new_text.replace(Position, Remove_Count, Insert_Text);
+        Focus_LineEdit->setText(new_text);
+        if (New_Cursor_State.Select_Begin == New_Cursor_State.Select_End)
+            Focus_LineEdit->setCursorPosition(New_Cursor_State.Cursor_Position);
+        else Focus_LineEdit->setSelection(anchor_position, New_Cursor_State.Cursor_Position - anchor_position);
     }
     else if (not (Focus_PlainTextEdit == nullptr)) {
-        Focus_PlainTextEdit->setPlainText(New_Text_State.Text);
-        QTextCursor txt_cursor = Focus_PlainTextEdit->textCursor();
-        txt_cursor.setPosition(New_Text_State.Cursor_Position);
-        Focus_PlainTextEdit->setTextCursor(txt_cursor);
+        QScrollBar *horizontal_scrollbar = Focus_PlainTextEdit->horizontalScrollBar();
+        QScrollBar *vertical_scrollbar = Focus_PlainTextEdit->verticalScrollBar();
+        int horizontal_value = horizontal_scrollbar->value();
+        int vertical_value = vertical_scrollbar->value();
+
+        QTextCursor edit_cursor(Focus_PlainTextEdit->document());
+        edit_cursor.beginEditBlock();
+        edit_cursor.setPosition(Position, QTextCursor::MoveAnchor);
+        edit_cursor.setPosition(Position + Remove_Count, QTextCursor::KeepAnchor);
+        edit_cursor.insertText(Insert_Text);
+        edit_cursor.endEditBlock();
+
+        Restore_Cursor_View(New_Cursor_State, horizontal_value, vertical_value);
+    }
+
+#if defined(UNDOREDO_METRICS)
+    Count_Latency(Counters.Restore_Latency, restore_timer.nsecsElapsed());
+#endif
+}
+
+void
+UndoRedo::Restore_Cursor_View ( Cursor_State New_Cursor_State, int Horizontal_Value, int Vertical_Value ) {
+    int anchor_position = New_Cursor_State.Select_Begin;
+    if (New_Cursor_State.Cursor_Position == New_Cursor_State.Select_Begin)
+        anchor_position = New_Cursor_State.Select_End;
+
+    QTextCursor txt_cursor = Focus_PlainTextEdit->textCursor();
+    txt_cursor.setPosition(anchor_position, QTextCursor::MoveAnchor);
+    txt_cursor.setPosition(New_Cursor_State.Cursor_Position, QTextCursor::KeepAnchor);
+    Focus_PlainTextEdit->setTextCursor(txt_cursor);
+
+    // Stay where the user was looking, scroll only if the cursor ...
+    // ... would otherwise be out of view
+    Focus_PlainTextEdit->horizontalScrollBar()->setValue(Horizontal_Value);
+    Focus_PlainTextEdit->verticalScrollBar()->setValue(Vertical_Value);
+    Focus_PlainTextEdit->ensureCursorVisible();
+}
+
+// Removal first, then insertion, never between the halves of a ...
+// ... surrogate pair
+bool
+UndoRedo::Restore_Chunk ( ) {
+    if (Restore_Remove_Count > 0) {
+        int chunk_length = qMin(Restore_Remove_Count, Restore_Chunk_Length);
+        if ((chunk_length < Restore_Remove_Count) and
+            Focus_PlainTextEdit->document()->characterAt(Restore_Position + chunk_length - 1).isHighSurrogate())
+            chunk_length += 1;
+        Restore_Cursor.setPosition(Restore_Position, QTextCursor::MoveAnchor);
+        Restore_Cursor.setPosition(Restore_Position + chunk_length, QTextCursor::KeepAnchor);
+        Restore_Cursor.removeSelectedText();
+        Restore_Remove_Count -= chunk_length;
     }
+    else if (Restore_Insert_Offset < Restore_Insert_Text.length()) {
+        int chunk_length = qMin(Restore_Insert_Text.length() - Restore_Insert_Offset, Restore_Chunk_Length);
+        if (((Restore_Insert_Offset + chunk_length) < Restore_Insert_Text.length()) and
+            Restore_Insert_Text.at(Restore_Insert_Offset + chunk_length - 1).isHighSurrogate())
+            chunk_length += 1;
+        Restore_Cursor.setPosition(Restore_Position + Restore_Insert_Offset, QTextCursor::MoveAnchor);
+        Restore_Cursor.insertText(Restore_Insert_Text.mid(Restore_Insert_Offset, chunk_length));
+        Restore_Insert_Offset += chunk_length;
+    }
+    return ((Restore_Remove_Count > 0) or (Restore_Insert_Offset < Restore_Insert_Text.length()));
+}
+
+void
+UndoRedo::timerEvent ( QTimerEvent *Event ) {
+    if (Event->timerId() == Restore_Timer.timerId()) Restore_Slice();
+#if defined(UNDOREDO_METRICS)
+    else if (Event->timerId() == Metrics_Timer.timerId()) Metrics_Timeout();
+#endif
+    else QObject::timerEvent(Event);
+}
+
+// One edit block (one relayout, one repaint) per slice, the event ...
+// ... loop gets its turn between slices
+void
+UndoRedo::Restore_Slice ( ) {
+    QElapsedTimer slice_timer;
+    slice_timer.start();
+
+    bool restore_remaining;
+    Restore_Cursor.beginEditBlock();
+    do restore_remaining = Restore_Chunk();
+    while (restore_remaining and (slice_timer.elapsed() < Restore_Slice_Milliseconds));
+    Restore_Cursor.endEditBlock();
+
+    if (not restore_remaining) Finish_Restore();
+}
+
+void
+UndoRedo::Complete_Restore ( ) {
+    if (not Restore_Active) return;
+    Restore_Timer.stop();
+
+    Restore_Cursor.beginEditBlock();
+    while (Restore_Chunk()) { }
+    Restore_Cursor.endEditBlock();
+
+    Restore_Active = false;
+    Restore_Insert_Text = QString();
+    Restore_Cursor = QTextCursor();
+    Focus_PlainTextEdit->setReadOnly(Restore_Read_Only);
+    Restore_Cursor_View(Restore_Cursor_State, Restore_Horizontal_Value, Restore_Vertical_Value);
+    History_Generation = Document_Generation;
+}
+
+void
+UndoRedo::Finish_Restore ( ) {
+    if (not Restore_Active) return;
+    Complete_Restore();
+
+    int queued_steps = Queued_Steps;
+    Queued_Steps = 0;
+    if (not (queued_steps == 0))
+        Go_To_History_Index(qBound(0, History_Index() + queued_steps, History_Length()));
+
+    // The merged steps may have started another
+    if (not Restore_Active) emit Restore_Finished();
+}
+
+bool
+UndoRedo::Text_Pending ( ) {
+    return ((not Restore_Active) and (not (Document_Generation == History_Generation)));
+}
+
+void
+UndoRedo::Set_Asynchronous_Restore ( bool New_Asynchronous_Restore ) {
+    if (not New_Asynchronous_Restore) Finish_Restore();
+    Asynchronous_Restore = New_Asynchronous_Restore;
+}
+
+bool
+UndoRedo::Is_Restoring ( ) {
+    return Restore_Active;
 }
 
 int
@@ -106,52 +399,1109 @@ UndoRedo::Selected_Count ( ) {
 
 
 // Begin ...
+UndoRedo::Text_Edit
+UndoRedo::Pending_Edit ( ) {
+    Text_Edit pending_edit;
+    pending_edit.Position = 0;
+    // History must be caught up before it is compared to anything
+    Materialize_Boundaries();
+
+    pending_edit.Before = History_Cursor;
+    pending_edit.After = Save_Cursor_State();
+
+    // Nothing has touched the text, at most the cursor has moved
+    if (Document_Generation == History_Generation) return pending_edit;
+
+    // Only the span the document reported as changed is compared, ...
+    // ... the cost is that of the edit, not of the document.
+    // Widgets w/o change ranges compare it all.
+    if (not (Focus_PlainTextEdit == nullptr)) {
+        int history_length = History.Length();
+        int current_length = Focus_PlainTextEdit->document()->characterCount() - 1;
+        int history_count = history_length - Changed_Begin - Changed_Tail;
+        int current_count = current_length - Changed_Begin - Changed_Tail;
+
+        if ((Changed_Begin >= 0) and (history_count >= 0) and (current_count >= 0)) {
+            Span_Edit(pending_edit, Changed_Begin, Changed_Tail, Current_Text(Changed_Begin, current_count));
+            return pending_edit;
+        }
+    }
+
+    QString current_text = Current_Text();
+
+    // Only the span between the common prefix and common suffix changed
+    int history_length = History.Length();
+    int current_length = current_text.length();
+    int shorter_length = qMin(history_length, current_length);
+
+    int prefix_length = History.Common_Prefix(current_text);
+    int suffix_length = History.Common_Suffix(current_text, shorter_length - prefix_length);
+
+    pending_edit.Position = prefix_length;
+    pending_edit.Removed = History.Slice(prefix_length, history_length - prefix_length - suffix_length);
+    pending_edit.Inserted = Take_Piece_List();
+    Insert_Pieces(pending_edit.Removed,
+                  current_text.midRef(prefix_length, current_length - prefix_length - suffix_length),
+                  pending_edit.Inserted);
+
+    return pending_edit;
+}
+
 void
-UndoRedo::Push_State ( Stack_Selector Select_Stack ) {
-    Text_State current_state = Save_Text_State();
-
-    if (Select_Stack == Select_Undo)
-        if (Undo_Stack.count() == 0)
-            Undo_Stack.push(current_state);
-        else {
-            Text_State previous_state = Undo_Stack.last();
-            // Prevent double pushing, push only if state is different ...
-            // ... worry less about "trash" on stack
-            if (not ((current_state.Text == previous_state.Text) and
-                     (current_state.Cursor_Position == previous_state.Cursor_Position) and
-                     (current_state.Select_Begin == previous_state.Select_Begin) and
-                     (current_state.Select_End == previous_state.Select_End))) {
-                Undo_Stack.push(current_state);
+UndoRedo::Span_Edit ( Text_Edit &Edit, int Span_Begin, int Span_Tail, const QString &Changed_Text ) {
+    int history_count = History.Length() - Span_Begin - Span_Tail;
+    int current_count = Changed_Text.length();
+
+    // Trim what the change left as it was (e.g. retyped characters), ...
+    // ... compared in place in History's buffers
+    PieceTable::Piece_List span_pieces = Take_Piece_List();
+    History.Slice(Span_Begin, history_count, span_pieces);
+    int shorter_length = qMin(history_count, current_count);
+    int prefix_length = History.Common_Prefix(span_pieces, Changed_Text);
+    prefix_length = qMin(prefix_length, shorter_length);
+    int suffix_length = History.Common_Suffix(span_pieces, Changed_Text, shorter_length - prefix_length);
+    Recycle_Piece_List(span_pieces);
+
+    Edit.Position = Span_Begin + prefix_length;
+    Edit.Removed = Take_Piece_List();
+    History.Slice(Edit.Position, history_count - prefix_length - suffix_length, Edit.Removed);
+    Edit.Inserted = Take_Piece_List();
+    Insert_Pieces(Edit.Removed, Changed_Text.midRef(prefix_length, current_count - prefix_length - suffix_length),
+                  Edit.Inserted);
+}
+
+// Lines end after their '\n', the last line may not
+static QVector<int>
+Line_Begins ( const QStringRef &Text ) {
+    QVector<int> line_begins;
+    line_begins.append(0);
+    for (int ch_idx = 0; ch_idx < Text.length(); ch_idx += 1) {
+        if (Text.at(ch_idx) == QChar('\n')) line_begins.append(ch_idx + 1);
+    }
+    if (not (line_begins.last() == Text.length())) line_begins.append(Text.length());
+    return line_begins;
+}
+
+static QVector<uint>
+Line_Hashes ( const QStringRef &Text, const QVector<int> &Line_Begins ) {
+    QVector<uint> line_hashes(Line_Begins.count() - 1);
+    for (int line_idx = 0; line_idx < line_hashes.count(); line_idx += 1)
+        line_hashes[line_idx] = qHash(Text.mid(Line_Begins.at(line_idx),
+                                               Line_Begins.at(line_idx + 1) - Line_Begins.at(line_idx)));
+    return line_hashes;
+}
+
+// Myers' O((N+M)D) diff over lines, w/ D bounded
+void
+UndoRedo::Insert_Pieces ( const PieceTable::Piece_List &Removed, const QStringRef &Inserted_Text,
+                          PieceTable::Piece_List &Inserted_Pieces ) {
+    if ((Inserted_Text.length() < Line_Diff_Minimum_Length) or Removed.isEmpty()) {
+        History.Append(Inserted_Text, Inserted_Pieces);
+        return;
+    }
+
+    QElapsedTimer diff_timer;
+    diff_timer.start();
+
+    QString removed_text = History.Text(Removed);
+    QStringRef removed_ref(&removed_text);
+    QVector<int> removed_lines = Line_Begins(removed_ref);
+    QVector<int> inserted_lines = Line_Begins(Inserted_Text);
+    QVector<uint> removed_hashes = Line_Hashes(removed_ref, removed_lines);
+    QVector<uint> inserted_hashes = Line_Hashes(Inserted_Text, inserted_lines);
+    int removed_count = removed_hashes.count();
+    int inserted_count = inserted_hashes.count();
+    if ((removed_count + inserted_count) > Maximum_Line_Diff_Lines) {
+        History.Append(Inserted_Text, Inserted_Pieces);
+        return;
+    }
+
+    auto lines_equal = [&] ( int Removed_Line, int Inserted_Line ) {
+        if (not (removed_hashes.at(Removed_Line) == inserted_hashes.at(Inserted_Line))) return false;
+        int removed_begin = removed_lines.at(Removed_Line);
+        int inserted_begin = inserted_lines.at(Inserted_Line);
+        return (removed_ref.mid(removed_begin, removed_lines.at(Removed_Line + 1) - removed_begin) ==
+                Inserted_Text.mid(inserted_begin, inserted_lines.at(Inserted_Line + 1) - inserted_begin));
+    };
+
+    // Furthest reaching path on each diagonal, kept for each distance
+    int maximum_distance = qMin(removed_count + inserted_count, Maximum_Line_Diff_Distance);
+    int diagonal_offset = maximum_distance + 1;
+    QVector<int> furthest(2 * maximum_distance + 3, 0);
+    QVector<QVector<int> > furthest_trace;
+    int found_distance = -1;
+    for (int distance = 0; (distance <= maximum_distance) and (found_distance < 0); distance += 1) {
+        // Out of time, found_distance stays -1 and it is all copied
+        if (diff_timer.elapsed() > Line_Diff_Budget_Milliseconds) break;
+        furthest_trace.append(furthest);
+        for (int diagonal = -distance; diagonal <= distance; diagonal += 2) {
+            int removed_line;
+            if ((diagonal == -distance) or
+                ((not (diagonal == distance)) and
+                 (furthest.at(diagonal - 1 + diagonal_offset) < furthest.at(diagonal + 1 + diagonal_offset))))
+                removed_line = furthest.at(diagonal + 1 + diagonal_offset);
+            else
+                removed_line = furthest.at(diagonal - 1 + diagonal_offset) + 1;
+            int inserted_line = removed_line - diagonal;
+            while ((removed_line < removed_count) and (inserted_line < inserted_count) and
+                   lines_equal(removed_line, inserted_line)) {
+                removed_line += 1;
+                inserted_line += 1;
+            }
+            furthest[diagonal + diagonal_offset] = removed_line;
+            if ((removed_line >= removed_count) and (inserted_line >= inserted_count)) {
+                found_distance = distance;
+                break;
             }
         }
-    else if (Select_Stack == Select_Redo)
-        Redo_Stack.push(current_state);
+    }
+
+    if (found_distance < 0) {
+        History.Append(Inserted_Text, Inserted_Pieces);
+        return;
+    }
+
+    // Walked back from the end, the runs of kept lines come out last first
+    struct Kept_Run { int Removed_Line; int Inserted_Line; int Line_Count; };
+    QVector<Kept_Run> kept_runs;
+    int removed_line = removed_count;
+    int inserted_line = inserted_count;
+    for (int distance = found_distance; distance >= 0; distance -= 1) {
+        int diagonal = removed_line - inserted_line;
+        int snake_removed_line = 0;
+        int previous_removed_line = 0;
+        int previous_inserted_line = 0;
+        if (distance > 0) {
+            const QVector<int> &previous = furthest_trace.at(distance);
+            int previous_diagonal;
+            if ((diagonal == -distance) or
+                ((not (diagonal == distance)) and
+                 (previous.at(diagonal - 1 + diagonal_offset) < previous.at(diagonal + 1 + diagonal_offset))))
+                previous_diagonal = diagonal + 1;
+            else
+                previous_diagonal = diagonal - 1;
+            previous_removed_line = previous.at(previous_diagonal + diagonal_offset);
+            previous_inserted_line = previous_removed_line - previous_diagonal;
+            snake_removed_line = (previous_diagonal == (diagonal + 1)) ? previous_removed_line
+                                                                       : previous_removed_line + 1;
+        }
+        if (removed_line > snake_removed_line) {
+            Kept_Run kept_run = { snake_removed_line, snake_removed_line - diagonal,
+                                  removed_line - snake_removed_line };
+            kept_runs.append(kept_run);
+        }
+        removed_line = previous_removed_line;
+        inserted_line = previous_inserted_line;
+    }
+
+    Inserted_Pieces.resize(0);
+    int inserted_position = 0;
+    for (int run_idx = kept_runs.count() - 1; run_idx >= 0; run_idx -= 1) {
+        const Kept_Run &kept_run = kept_runs.at(run_idx);
+        int run_inserted_begin = inserted_lines.at(kept_run.Inserted_Line);
+        if (run_inserted_begin > inserted_position)
+            Inserted_Pieces += History.Append(Inserted_Text.mid(inserted_position,
+                                                                run_inserted_begin - inserted_position));
+        int run_removed_begin = removed_lines.at(kept_run.Removed_Line);
+        int run_length = removed_lines.at(kept_run.Removed_Line + kept_run.Line_Count) - run_removed_begin;
+        Inserted_Pieces += PieceTable::Slice(Removed, run_removed_begin, run_length);
+        inserted_position = run_inserted_begin + run_length;
+    }
+    if (Inserted_Text.length() > inserted_position)
+        Inserted_Pieces += History.Append(Inserted_Text.mid(inserted_position,
+                                                            Inserted_Text.length() - inserted_position));
+}
+
+PieceTable::Piece_List
+UndoRedo::Take_Piece_List ( ) {
+    if (Piece_List_Pool.isEmpty()) return PieceTable::Piece_List();
+    return Piece_List_Pool.takeLast();
+}
+
+// An edit set aside as a branch may still share the list, clear ...
+// ... lets go of shared storage and reserve gives the pooled list ...
+// ... storage of its own (neither allocates for an unshared list).
+void
+UndoRedo::Recycle_Piece_List ( PieceTable::Piece_List &Pieces ) {
+    int pieces_capacity = Pieces.capacity();
+    if ((pieces_capacity > 0) and (Piece_List_Pool.count() < Maximum_Piece_List_Pool_Count)) {
+        Pieces.clear();
+        Pieces.reserve(pieces_capacity);
+        Piece_List_Pool.append(Pieces);
+    }
+    Pieces = PieceTable::Piece_List();
+}
+
+void
+UndoRedo::Recycle_Edit ( Text_Edit &Edit ) {
+    Recycle_Piece_List(Edit.Removed);
+    Recycle_Piece_List(Edit.Inserted);
+}
+
+bool
+UndoRedo::Mark_Boundary ( ) {
+    // Only while the document reports exact change ranges
+    if ((not History_Valid) or (Focus_PlainTextEdit == nullptr)) return false;
+
+    Boundary_Marker marker;
+    marker.Changed_Begin = 0;
+    marker.Changed_Tail = 0;
+    marker.Text_Changed = (not (Document_Generation == History_Generation));
+    marker.Before = History_Cursor;
+    marker.After = Save_Cursor_State();
+    marker.Serial = 0;
+    marker.Time = 0;
+
+    if (marker.Text_Changed) {
+        int current_count = Focus_PlainTextEdit->document()->characterCount() - 1 - Changed_Begin - Changed_Tail;
+        if ((Changed_Begin < 0) or (current_count < 0)) return false;
+
+        marker.Changed_Begin = Changed_Begin;
+        marker.Changed_Tail = Changed_Tail;
+        marker.Changed_Text = Current_Text(Changed_Begin, current_count);
+    }
+    // Prevent double pushing, same as Push_State
+    else if ((marker.Before.Cursor_Position == marker.After.Cursor_Position) and
+             (marker.Before.Select_Begin == marker.After.Select_Begin) and
+             (marker.Before.Select_End == marker.After.Select_End)) {
+#if defined(UNDOREDO_METRICS)
+        Counters.Push_Suppressed_Count += 1;
+#endif
+        return true;
+    }
+
+    // Ordered as of now, not as of materializing
+    marker.Serial = Next_Serial();
+    marker.Time = QDateTime::currentMSecsSinceEpoch();
+    Boundary_Markers.append(marker);
+    History_Cursor = marker.After;
+    History_Generation = Document_Generation;
+
+    if ((Boundary_Markers.count() >= Maximum_Boundary_Marker_Count) or (not (Journal == nullptr)))
+        Materialize_Boundaries();
+    return true;
+}
+
+void
+UndoRedo::Materialize_Boundaries ( ) {
+    if (Boundary_Markers.isEmpty()) return;
+
+    // Taken first, Push_Edit must not find them again
+    QVector<Boundary_Marker> boundary_markers;
+    boundary_markers.swap(Boundary_Markers);
+
+    for (const Boundary_Marker &marker : boundary_markers) {
+        Text_Edit marker_edit;
+        marker_edit.Position = 0;
+        marker_edit.Serial = marker.Serial;
+        marker_edit.Time = marker.Time;
+        marker_edit.Before = marker.Before;
+        marker_edit.After = marker.After;
+        if (marker.Text_Changed)
+            Span_Edit(marker_edit, marker.Changed_Begin, marker.Changed_Tail, marker.Changed_Text);
+
+        if (Is_Null_Edit(marker_edit)) {
+#if defined(UNDOREDO_METRICS)
+            Counters.Push_Suppressed_Count += 1;
+#endif
+            Recycle_Edit(marker_edit);
+            continue;
+        }
+
+#if defined(UNDOREDO_METRICS)
+        Counters.Push_Count += 1;
+#endif
+        Push_Edit(Select_Undo, marker_edit);
+        History.Replace(marker_edit.Position, PieceTable::Length(marker_edit.Removed), marker_edit.Inserted);
+        Keyframe_Undo_Top();
+    }
+
+    // Handed back emptied, so its capacity serves the next markers
+    boundary_markers.resize(0);
+    if (Boundary_Markers.isEmpty()) Boundary_Markers.swap(boundary_markers);
+
+    Compact_Journal();
+    Schedule_Compression();
+}
+
+bool
+UndoRedo::Is_Null_Edit ( const Text_Edit &Edit ) {
+    return (Edit.Removed.isEmpty() and Edit.Inserted.isEmpty() and
+            (Edit.Before.Cursor_Position == Edit.After.Cursor_Position) and
+            (Edit.Before.Select_Begin == Edit.After.Select_Begin) and
+            (Edit.Before.Select_End == Edit.After.Select_End));
+}
+
+void
+UndoRedo::Apply_Edit ( const Text_Edit &Edit, Stack_Selector Direction ) {
+    // The restored state is the new boundary, nothing is pending
+    if (Direction == Select_Undo) {
+        int inserted_length = PieceTable::Length(Edit.Inserted);
+        History.Replace(Edit.Position, inserted_length, Edit.Removed);
+        History_Cursor = Edit.Before;
+        Restore_Text_State(Edit.Position, inserted_length, History.Text(Edit.Removed), History_Cursor);
+        History_Generation = Document_Generation;
+    }
+    else if (Direction == Select_Redo) {
+        int removed_length = PieceTable::Length(Edit.Removed);
+        History.Replace(Edit.Position, removed_length, Edit.Inserted);
+        History_Cursor = Edit.After;
+        Restore_Text_State(Edit.Position, removed_length, History.Text(Edit.Inserted), History_Cursor);
+        History_Generation = Document_Generation;
+    }
+}
+
+bool
+UndoRedo::Push_State ( Stack_Selector Select_Stack ) {
+    if (not History_Valid) {
+        // First boundary, nothing to record yet
+        Keyframes_Clear();
+        History.Load(Current_Text());
+        History_Cursor = Save_Cursor_State();
+        History_Generation = Document_Generation;
+        History_Valid = true;
+        return false;
+    }
+
+    Text_Edit pending_edit = Pending_Edit();
+    // Prevent double pushing, push only if state is different ...
+    // ... worry less about "trash" on stack
+    if (Is_Null_Edit(pending_edit)) {
+#if defined(UNDOREDO_METRICS)
+        if (Select_Stack == Select_Undo) Counters.Push_Suppressed_Count += 1;
+#endif
+        return false;
+    }
+
+    if (Select_Stack == Select_Undo) {
+#if defined(UNDOREDO_METRICS)
+        Counters.Push_Count += 1;
+#endif
+        Push_Edit(Select_Undo, pending_edit);
+        History.Replace(pending_edit.Position, PieceTable::Length(pending_edit.Removed), pending_edit.Inserted);
+        Keyframe_Undo_Top();
+        History_Cursor = pending_edit.After;
+        History_Generation = Document_Generation;
+    }
+    else if (Select_Stack == Select_Redo) {
+        Push_Edit(Select_Redo, pending_edit);
+        // Back to the last boundary, from where it can be redone
+        Restore_Text_State(pending_edit.Position, PieceTable::Length(pending_edit.Inserted),
+                           History.Text(pending_edit.Removed), History_Cursor);
+        History_Generation = Document_Generation;
+    }
+
+    return true;
 }
 
 void
 UndoRedo::Pop_State ( Stack_Selector Select_Stack ) {
-    Text_State current_state;
-    if (Select_Stack == Select_Undo)
-        current_state = Undo_Stack.pop();
-    else if (Select_Stack == Select_Redo)
-        current_state = Redo_Stack.pop();
+    if (Select_Stack == Select_Undo) {
+        if (Undo_Stack.count() == 0) return;
+        Text_Edit undo_edit = Pop_Edit(Select_Undo);
+        Push_Edit(Select_Redo, undo_edit);
+        Apply_Edit(undo_edit, Select_Undo);
+    }
+    else if (Select_Stack == Select_Redo) {
+        if (Redo_Stack.count() == 0) return;
+        Text_Edit redo_edit = Pop_Edit(Select_Redo);
+        Push_Edit(Select_Undo, redo_edit);
+        Apply_Edit(redo_edit, Select_Redo);
+    }
+}
+
+void
+UndoRedo::Pop_States ( Stack_Selector Select_Stack, int Steps ) {
+    Steps = qMin(Steps, (Select_Stack == Select_Undo) ? Undo_Stack.count() : Redo_Stack.count());
+    if (Steps <= 0) return;
+
+    // Path indexes do not change as edits move between the stacks
+    int step_direction = (Select_Stack == Select_Undo) ? -1 : 1;
+    int state_index = Undo_Stack.count();
+    int target_index = state_index + (step_direction * Steps);
+
+    // Nearest the target, History skips straight to it
+    int keyframe_index = -1;
+    if (Steps > 1) {
+        for (int path_idx = target_index; not (path_idx == state_index); path_idx -= step_direction) {
+            if (Keyframes.contains(Path_Serial(path_idx))) {
+                keyframe_index = path_idx;
+                break;
+            }
+        }
+    }
+
+    // Unchanged lengths at either end, the same in the widget's text ...
+    // ... (History as it was) and in History as it ends up, ...
+    // ... tracked by length so the edits skipped need no History.
+    int widget_length = History.Length();
+    int history_length = widget_length;
+    int unchanged_begin = widget_length;
+    int unchanged_tail = widget_length;
+    for (int step_idx = 0; step_idx < Steps; step_idx += 1) {
+        Text_Edit popped_edit = Pop_Edit(Select_Stack);
+        Push_Edit((Select_Stack == Select_Undo) ? Select_Redo : Select_Undo, popped_edit);
+
+        const PieceTable::Piece_List &replaced_pieces =
+            (Select_Stack == Select_Undo) ? popped_edit.Inserted : popped_edit.Removed;
+        const PieceTable::Piece_List &new_pieces =
+            (Select_Stack == Select_Undo) ? popped_edit.Removed : popped_edit.Inserted;
+        int replaced_length = PieceTable::Length(replaced_pieces);
+        unchanged_begin = qMin(unchanged_begin, popped_edit.Position);
+        unchanged_tail = qMin(unchanged_tail, history_length - popped_edit.Position - replaced_length);
+        history_length += PieceTable::Length(new_pieces) - replaced_length;
+        History_Cursor = (Select_Stack == Select_Undo) ? popped_edit.Before : popped_edit.After;
+
+        state_index += step_direction;
+        if (state_index == keyframe_index)
+            History.Restore_Pieces(Keyframes.value(Path_Serial(keyframe_index)));
+        else if ((keyframe_index < 0) or (((keyframe_index - state_index) * step_direction) < 0))
+            History.Replace(popped_edit.Position, replaced_length, new_pieces);
+    }
+    unchanged_tail = qMin(unchanged_tail, qMin(widget_length, history_length) - unchanged_begin);
+
+    int restore_count = History.Length() - unchanged_begin - unchanged_tail;
+    Restore_Text_State(unchanged_begin, widget_length - unchanged_begin - unchanged_tail,
+                       History.Text(History.Slice(unchanged_begin, restore_count)), History_Cursor);
+    History_Generation = Document_Generation;
+}
+
+const UndoRedo::Text_Edit &
+UndoRedo::Path_Edit ( int Index ) {
+    if (Index < Undo_Stack.count()) return Undo_Stack.at(Index);
+    return Redo_Stack.at(Redo_Stack.count() - 1 - (Index - Undo_Stack.count()));
+}
+
+quint64
+UndoRedo::Path_Serial ( int Index ) {
+    if (Index == 0) return Base_Serial;
+    return Path_Edit(Index - 1).Serial;
+}
+
+void
+UndoRedo::Keyframe_Undo_Top ( ) {
+    if ((Undo_Stack.count() == 0) or
+        ((Keyframe_Edit_Count == 0) and (Keyframe_Change_Bytes == 0))) return;
+
+    Keyframe_Edits += 1;
+    Keyframe_Bytes += Edit_Bytes(Undo_Stack.top());
+    if (((Keyframe_Edit_Count > 0) and (Keyframe_Edits >= Keyframe_Edit_Count)) or
+        ((Keyframe_Change_Bytes > 0) and (Keyframe_Bytes >= Keyframe_Change_Bytes))) {
+        Keyframes.insert(Undo_Stack.top().Serial, History.Pieces());
+        Keyframe_Edits = 0;
+        Keyframe_Bytes = 0;
+    }
+}
+
+void
+UndoRedo::Keyframes_Clear ( ) {
+    Keyframes.clear();
+    Keyframe_Edits = 0;
+    Keyframe_Bytes = 0;
+}
+
+void
+UndoRedo::Set_Keyframe_Interval ( int New_Keyframe_Edit_Count, qint64 New_Keyframe_Change_Bytes ) {
+    Keyframe_Edit_Count = qMax(0, New_Keyframe_Edit_Count);
+    Keyframe_Change_Bytes = qMax(qint64(0), New_Keyframe_Change_Bytes);
+    if ((Keyframe_Edit_Count == 0) and (Keyframe_Change_Bytes == 0)) Keyframes_Clear();
+}
+
+// Inserted text is counted since the edit is what keeps it in the ...
+// ... add buffer, removed text is still shared w/ earlier states.
+qint64
+UndoRedo::Edit_Bytes ( const Text_Edit &Edit ) {
+    return (qint64(sizeof(Text_Edit)) +
+            ((Edit.Removed.count() + Edit.Inserted.count()) * qint64(sizeof(PieceTable::Piece))) +
+            (PieceTable::Length(Edit.Inserted) * qint64(sizeof(QChar))));
+}
+
+void
+UndoRedo::Push_Edit ( Stack_Selector Select_Stack, const Text_Edit &Edit ) {
+    Text_Edit pushed_edit = Edit;
+    if (pushed_edit.Serial == 0) {
+        pushed_edit.Serial = Next_Serial();
+        pushed_edit.Time = QDateTime::currentMSecsSinceEpoch();
+    }
+    qint64 edit_bytes = Edit_Bytes(pushed_edit);
+
+    if (Select_Stack == Select_Undo) {
+        Enforce_Undo_Capacity(1, edit_bytes);
+        Undo_Stack.push(pushed_edit);
+        Undo_Bytes += edit_bytes;
+
+        // Into the hot edits, pushing the deepest one out of them
+        if (Compress_Depth > 0) {
+            Count_Hot_Edit(pushed_edit, 1);
+            int cooled_idx = Undo_Stack.count() - 1 - Compress_Depth;
+            if (cooled_idx >= 0) Count_Hot_Edit(Undo_Stack.at(cooled_idx), -1);
+        }
+    }
+    else if (Select_Stack == Select_Redo) {
+        if (Redo_Stack.count() == Redo_Stack.capacity()) {
+            Redo_Bytes -= Edit_Bytes(Redo_Stack.first());
+            Drop_Branches_At(Redo_Stack.first().Serial);
+            Keyframes.remove(Redo_Stack.first().Serial);
+            Count_Hot_Edit(Redo_Stack.first(), -1);
+            Recycle_Edit(Redo_Stack[0]);
+            Redo_Stack.removeFirst();
+            Journal_Append(Journal_Evict, Select_Redo);
+        }
+        Redo_Stack.push(pushed_edit);
+        Redo_Bytes += edit_bytes;
+        Count_Hot_Edit(pushed_edit, 1);
+    }
+
+    Journal_Append(Journal_Push, Select_Stack, &pushed_edit);
+}
+
+UndoRedo::Text_Edit
+UndoRedo::Pop_Edit ( Stack_Selector Select_Stack ) {
+    Text_Edit popped_edit;
+
+    if (Select_Stack == Select_Undo) {
+        popped_edit = Undo_Stack.pop();
+        Undo_Bytes -= Edit_Bytes(popped_edit);
+
+        // Out of the hot edits, the next deepest one comes into them
+        if (Compress_Depth > 0) {
+            Count_Hot_Edit(popped_edit, -1);
+            int warmed_idx = Undo_Stack.count() - Compress_Depth;
+            if (warmed_idx >= 0) Count_Hot_Edit(Undo_Stack.at(warmed_idx), 1);
+        }
+    }
+    else if (Select_Stack == Select_Redo) {
+        popped_edit = Redo_Stack.pop();
+        Redo_Bytes -= Edit_Bytes(popped_edit);
+        Count_Hot_Edit(popped_edit, -1);
+    }
+
+    Journal_Append(Journal_Pop, Select_Stack);
+
+    if (popped_edit.Journal_Record >= 0) Read_Journal_Edit(popped_edit);
+    return popped_edit;
+}
+
+// Makes room for Reserve_Count more edits totalling Reserve_Bytes, ...
+// ... oldest edits go first
+void
+UndoRedo::Enforce_Undo_Capacity ( int Reserve_Count, qint64 Reserve_Bytes ) {
+    // Alternatives go before the path actually taken
+    while ((Branches.count() > 0) and
+           (Maximum_Undo_Bytes > 0) and
+           ((Undo_Bytes + Redo_Bytes + Branch_Bytes + Reserve_Bytes) > Maximum_Undo_Bytes))
+        Drop_Branch(0);
+
+    while ((Undo_Stack.count() > 0) and
+           (((Undo_Stack.count() + Reserve_Count) > Maximum_Undo_Count) or
+            ((Maximum_Undo_Bytes > 0) and
+             ((Undo_Bytes + Redo_Bytes + Reserve_Bytes) > Maximum_Undo_Bytes)))) {
+        // The state below the oldest edit can no longer be reached
+        Drop_Branches_At(Base_Serial);
+        Keyframes.remove(Base_Serial);
+        Base_Serial = Undo_Stack.first().Serial;
+
+        Undo_Bytes -= Edit_Bytes(Undo_Stack.first());
+        if (Undo_Stack.count() <= Compress_Depth) Count_Hot_Edit(Undo_Stack.first(), -1);
+        Recycle_Edit(Undo_Stack[0]);
+        Undo_Stack.removeFirst();
+        Journal_Append(Journal_Evict, Select_Undo);
+#if defined(UNDOREDO_METRICS)
+        Counters.Evict_Count += 1;
+#endif
+    }
+}
+
+void
+UndoRedo::Recount_Bytes ( ) {
+    Hot_References_Valid = false;
+
+    Undo_Bytes = 0;
+    for (int edit_idx = 0; edit_idx < Undo_Stack.count(); edit_idx += 1)
+        Undo_Bytes += Edit_Bytes(Undo_Stack.at(edit_idx));
+
+    Redo_Bytes = 0;
+    for (int edit_idx = 0; edit_idx < Redo_Stack.count(); edit_idx += 1)
+        Redo_Bytes += Edit_Bytes(Redo_Stack.at(edit_idx));
+
+    Branch_Bytes = 0;
+    for (const Undo_Branch &branch : Branches)
+        for (const Text_Edit &branch_edit : branch.Edits) Branch_Bytes += Edit_Bytes(branch_edit);
+}
+
+void
+UndoRedo::Set_Maximum_Undo_Count ( int New_Maximum_Undo_Count ) {
+    Maximum_Undo_Count = qMax(1, New_Maximum_Undo_Count);
+    Enforce_Undo_Capacity(0, 0);
+
+    Undo_Stack.setCapacity(Maximum_Undo_Count);
+    // Redo also holds what was pending when undo started
+    Redo_Stack.setCapacity(Maximum_Undo_Count + 1);
+
+    Recount_Bytes();
+}
+
+void
+UndoRedo::Set_Maximum_Undo_Bytes ( qint64 New_Maximum_Undo_Bytes ) {
+    Maximum_Undo_Bytes = qMax(qint64(0), New_Maximum_Undo_Bytes);
+    Enforce_Undo_Capacity(0, 0);
+}
+
+void
+UndoRedo::Set_Compress_Depth ( int New_Compress_Depth ) {
+    Compress_Depth = qMax(0, New_Compress_Depth);
+    Hot_References_Valid = false;
+    Schedule_Compression();
+}
+
+void
+UndoRedo::Count_Hot_Edit ( const Text_Edit &Edit, int Delta ) {
+    if (not Hot_References_Valid) return;
+    if (Hot_References.count() < History.Buffer_Count()) Hot_References.resize(History.Buffer_Count());
+    for (const PieceTable::Piece &piece : Edit.Removed) Hot_References[piece.Buffer] += Delta;
+    for (const PieceTable::Piece &piece : Edit.Inserted) Hot_References[piece.Buffer] += Delta;
+}
+
+void
+UndoRedo::Recount_Hot_References ( ) {
+    Hot_References.fill(0, History.Buffer_Count());
+    Hot_References_Valid = true;
+
+    int undo_count = Undo_Stack.count();
+    for (int edit_idx = qMax(0, undo_count - Compress_Depth); edit_idx < undo_count; edit_idx += 1)
+        Count_Hot_Edit(Undo_Stack.at(edit_idx), 1);
+    for (int edit_idx = 0; edit_idx < Redo_Stack.count(); edit_idx += 1)
+        Count_Hot_Edit(Redo_Stack.at(edit_idx), 1);
+}
+
+// Buffers the document, the redo edits or the most recent undo edits ...
+// ... refer to, i.e. whatever an undo or two is likely to read.
+bool
+UndoRedo::Is_Buffer_Hot ( int Buffer ) {
+    if (not Hot_References_Valid) Recount_Hot_References();
+    if (History.Is_Buffer_In_Document(Buffer)) return true;
+    return ((Buffer < Hot_References.count()) and (Hot_References.at(Buffer) > 0));
+}
+
+void
+UndoRedo::Schedule_Compression ( ) {
+    if ((Compress_Depth == 0) or ((not (Compress_Watcher == nullptr)) and Compress_Watcher->isRunning())) return;
+
+    for (int buffer_idx = 0; buffer_idx < History.Buffer_Count(); buffer_idx += 1) {
+        if (History.Is_Buffer_Compressible(buffer_idx) and (not Is_Buffer_Hot(buffer_idx))) {
+            // The worker's copy shares the text, nothing is copied here ...
+            // ... and blocks are never written once full
+            QString buffer_text = History.Buffer_Text(buffer_idx);
+            Compress_Buffer = buffer_idx;
+            if (Compress_Watcher == nullptr) {
+                Compress_Watcher = new QFutureWatcher<QByteArray>(this);
+                connect(Compress_Watcher, SIGNAL(finished()), this, SLOT(Compression_Finished()));
+            }
+            Compress_Watcher->setFuture(QtConcurrent::run([buffer_text] ( ) {
+                return qCompress(QByteArray::fromRawData(reinterpret_cast<const char*>(buffer_text.constData()),
+                                                         buffer_text.length() * int(sizeof(QChar))));
+            }));
+            return;
+        }
+    }
+}
+
+void
+UndoRedo::Compression_Finished ( ) {
+    // The buffer may have been reused or undone back into view meanwhile
+    if ((Compress_Buffer >= 0) and (Compress_Buffer < History.Buffer_Count()) and
+        (not Is_Buffer_Hot(Compress_Buffer)))
+        History.Compress_Buffer(Compress_Buffer, Compress_Watcher->result());
+    Compress_Buffer = -1;
 
-    Restore_Text_State(current_state);
+    Schedule_Compression();
 }
 
 void
 UndoRedo::Undo_Stack_Clear ( ) {
+    // History is then as of the last boundary
+    Materialize_Boundaries();
+
+    // Whatever hangs off the current state stays reachable, ...
+    // ... as does its keyframe
+    quint64 new_base_serial = Undo_Top_Serial();
+    if (not (Base_Serial == new_base_serial)) {
+        Drop_Branches_At(Base_Serial);
+        Keyframes.remove(Base_Serial);
+    }
+    for (int edit_idx = 0; edit_idx < (Undo_Stack.count() - 1); edit_idx += 1) {
+        Drop_Branches_At(Undo_Stack.at(edit_idx).Serial);
+        Keyframes.remove(Undo_Stack.at(edit_idx).Serial);
+    }
+    Base_Serial = new_base_serial;
+
+    if (Undo_Stack.count() > 0) Journal_Append(Journal_Clear, Select_Undo);
     Undo_Stack.clear();
+    Undo_Bytes = 0;
+    Hot_References_Valid = false;
 }
 
 void
 UndoRedo::Redo_Stack_Clear ( ) {
+    // Not under a restore still being applied
+    Finish_Restore();
+    Set_Aside_Redo(Undo_Top_Serial());
+}
+
+void
+UndoRedo::Redo_Stack_Discard ( bool Keep_Branches ) {
+    if (Redo_Stack.count() > 0) Journal_Append(Journal_Clear, Select_Redo);
+    for (int edit_idx = 0; edit_idx < Redo_Stack.count(); edit_idx += 1) {
+        if (not Keep_Branches) Drop_Branches_At(Redo_Stack.at(edit_idx).Serial);
+        Keyframes.remove(Redo_Stack.at(edit_idx).Serial);
+        Recycle_Edit(Redo_Stack[edit_idx]);
+    }
     Redo_Stack.clear();
+    Redo_Bytes = 0;
+    Hot_References_Valid = false;
+}
+
+quint64
+UndoRedo::Undo_Top_Serial ( ) {
+    if (Undo_Stack.count() > 0) return Undo_Stack.top().Serial;
+    return Base_Serial;
+}
+
+void
+UndoRedo::Set_Aside_Redo ( quint64 Parent_Serial ) {
+    if (Redo_Stack.count() == 0) return;
+
+    Undo_Branch new_branch;
+    new_branch.Parent_Serial = Parent_Serial;
+    new_branch.Edits.reserve(Redo_Stack.count());
+    for (int edit_idx = 0; edit_idx < Redo_Stack.count(); edit_idx += 1) {
+        Text_Edit branch_edit = Redo_Stack.at(edit_idx);
+        if (branch_edit.Journal_Record >= 0) Read_Journal_Edit(branch_edit);
+        Branch_Bytes += Edit_Bytes(branch_edit);
+        new_branch.Edits.append(branch_edit);
+    }
+    Branches.append(new_branch);
+    Redo_Stack_Discard(true);
+
+    while (Branches.count() > Maximum_Branch_Count) Drop_Branch(0);
+}
+
+// Branches hanging off the dropped one's edits go with it
+void
+UndoRedo::Drop_Branch ( int Branch ) {
+    Undo_Branch dropped_branch = Branches.takeAt(Branch);
+    for (Text_Edit &branch_edit : dropped_branch.Edits) {
+        Branch_Bytes -= Edit_Bytes(branch_edit);
+        Drop_Branches_At(branch_edit.Serial);
+        Keyframes.remove(branch_edit.Serial);
+        Recycle_Edit(branch_edit);
+    }
+}
+
+void
+UndoRedo::Drop_Branches_At ( quint64 Parent_Serial ) {
+    for (int branch_idx = Branches.count() - 1; branch_idx >= 0; branch_idx -= 1) {
+        // Dropping may remove others, stay in range
+        if (branch_idx >= Branches.count()) continue;
+        if (Branches.at(branch_idx).Parent_Serial == Parent_Serial) Drop_Branch(branch_idx);
+    }
 }
 
+int
+UndoRedo::Branch_Count ( ) {
+    return Branches.count();
+}
+
+int
+UndoRedo::Branch_Edit_Count ( int Branch ) {
+    if ((Branch < 0) or (Branch >= Branches.count())) return 0;
+    return Branches.at(Branch).Edits.count();
+}
+
+// The text the branch's first edit inserts, to tell branches apart
+QString
+UndoRedo::Branch_Preview ( int Branch ) {
+    if ((Branch < 0) or (Branch >= Branches.count()) or Branches.at(Branch).Edits.isEmpty()) return QString();
+    return History.Text(Branches.at(Branch).Edits.last().Inserted);
+}
+
+bool
+UndoRedo::Switch_Branch ( int Branch ) {
+    Finish_Restore();
+    if ((Branch < 0) or (Branch >= Branches.count()) or (not History_Valid)) return false;
+
+    // Undo_Top_Serial must be that of the last boundary
+    Materialize_Boundaries();
+
+    if (not (Focus_PlainTextEdit == nullptr)) Focus_PlainTextEdit->removeTextCursorIndicator();
+
+    Undo_Branch target_branch = Branches.takeAt(Branch);
+    for (const Text_Edit &branch_edit : target_branch.Edits) Branch_Bytes -= Edit_Bytes(branch_edit);
+
+    // Whatever is pending becomes an edit of the current path, ...
+    // ... redo no longer follows from it
+    quint64 pending_parent_serial = Undo_Top_Serial();
+    if (Push_State(Select_Undo)) Set_Aside_Redo(pending_parent_serial);
+
+    // Where the branch hangs off, back down the undo stack or ...
+    // ... forward along the redo stack
+    int undo_steps = -1;
+    if (target_branch.Parent_Serial == Base_Serial) undo_steps = Undo_Stack.count();
+    for (int edit_idx = Undo_Stack.count() - 1; edit_idx >= 0; edit_idx -= 1) {
+        if (Undo_Stack.at(edit_idx).Serial == target_branch.Parent_Serial) {
+            undo_steps = Undo_Stack.count() - 1 - edit_idx;
+            break;
+        }
+    }
+    int redo_steps = -1;
+    for (int edit_idx = Redo_Stack.count() - 1; edit_idx >= 0; edit_idx -= 1) {
+        if (Redo_Stack.at(edit_idx).Serial == target_branch.Parent_Serial) {
+            redo_steps = Redo_Stack.count() - edit_idx;
+            break;
+        }
+    }
+
+    if ((undo_steps < 0) and (redo_steps < 0)) {
+        // Evicted meanwhile, nothing to switch to
+        Branches.append(target_branch);
+        Recount_Bytes();
+        return false;
+    }
+
+    Pop_States(Select_Undo, undo_steps);
+    Pop_States(Select_Redo, redo_steps);
+
+    Set_Aside_Redo(Undo_Top_Serial());
+    for (const Text_Edit &branch_edit : target_branch.Edits) Push_Edit(Select_Redo, branch_edit);
+    Pop_States(Select_Redo, Redo_Stack.count());
+
+    Do_State.truncate(0);
+    return true;
+}
+
+QByteArray
+UndoRedo::Journal_Record_Bytes ( Journal_Op Op, Stack_Selector Select_Stack, const Text_Edit *Edit ) {
+    QByteArray record;
+    QDataStream record_stream(&record, QIODevice::WriteOnly);
+    record_stream << quint8(Op) << quint8(Select_Stack);
+    if (not (Edit == nullptr)) {
+        // Serial and time first, Open_Journal reads just those
+        record_stream << quint64(Edit->Serial) << qint64(Edit->Time)
+                      << qint32(Edit->Position)
+                      << History.Text(Edit->Removed) << History.Text(Edit->Inserted)
+                      << qint32(Edit->Before.Select_Begin) << qint32(Edit->Before.Select_End)
+                      << qint32(Edit->Before.Cursor_Position)
+                      << qint32(Edit->After.Select_Begin) << qint32(Edit->After.Select_End)
+                      << qint32(Edit->After.Cursor_Position);
+    }
+
+    return record;
+}
+
+void
+UndoRedo::Journal_Append ( Journal_Op Op, Stack_Selector Select_Stack, const Text_Edit *Edit ) {
+    if (Journal == nullptr) return;
+
+    Journal->Append(Journal_Record_Bytes(Op, Select_Stack, Edit));
+}
+
+// Reads a journaled edit in place, its text joins History's add buffer
+void
+UndoRedo::Read_Journal_Edit ( Text_Edit &Edit ) {
+    QDataStream record_stream(Journal->Record(Edit.Journal_Record));
+    quint8 journal_op, journal_stack;
+    quint64 serial;
+    qint64 time;
+    qint32 position;
+    QString removed_text, inserted_text;
+    qint32 before_select_begin, before_select_end, before_cursor_position;
+    qint32 after_select_begin, after_select_end, after_cursor_position;
+    record_stream >> journal_op >> journal_stack >> serial >> time >> position >> removed_text >> inserted_text
+                  >> before_select_begin >> before_select_end >> before_cursor_position
+                  >> after_select_begin >> after_select_end >> after_cursor_position;
+
+    Edit.Position = position;
+    Edit.Removed = History.Append(QStringRef(&removed_text));
+    Edit.Inserted = History.Append(QStringRef(&inserted_text));
+    Edit.Before.Select_Begin = before_select_begin;
+    Edit.Before.Select_End = before_select_end;
+    Edit.Before.Cursor_Position = before_cursor_position;
+    Edit.After.Select_Begin = after_select_begin;
+    Edit.After.Select_End = after_select_end;
+    Edit.After.Cursor_Position = after_cursor_position;
+    Edit.Journal_Record = -1;
+}
+
+bool
+UndoRedo::Journal_Edit_Fits ( const QByteArray &Record, Stack_Selector Select_Stack ) {
+    QDataStream record_stream(Record);
+    quint8 journal_op, journal_stack;
+    quint64 serial;
+    qint64 time;
+    qint32 position;
+    QString removed_text, inserted_text;
+    record_stream >> journal_op >> journal_stack >> serial >> time >> position >> removed_text >> inserted_text;
+    if (not (record_stream.status() == QDataStream::Ok)) return false;
+
+    const QString &expected_text = (Select_Stack == Select_Undo) ? inserted_text : removed_text;
+    return (Current_Text(position, expected_text.length()) == expected_text);
+}
+
+bool
+UndoRedo::Open_Journal ( const QString &Journal_Path ) {
+    Finish_Restore();
+    Close_Journal();
+
+    UndoJournal *new_journal = new UndoJournal();
+    if (not new_journal->Open(Journal_Path)) {
+        delete new_journal;
+        return false;
+    }
+
+    // Replay the stack operations as record numbers, edits stay in ...
+    // ... the journal for now
+    RingBuffer<int> undo_records(Undo_Stack.capacity());
+    RingBuffer<int> redo_records(Redo_Stack.capacity());
+    for (int record_idx = 0; record_idx < new_journal->Record_Count(); record_idx += 1) {
+        QByteArray record = new_journal->Record(record_idx);
+        if (record.size() < 2) continue;
+
+        RingBuffer<int> &record_stack =
+                (quint8(record.at(1)) == quint8(Select_Undo)) ? undo_records : redo_records;
+        switch (quint8(record.at(0))) {
+        case Journal_Push:
+            record_stack.push(record_idx);
+            break;
+        case Journal_Pop:
+            if (record_stack.count() > 0) record_stack.pop();
+            break;
+        case Journal_Evict:
+            if (record_stack.count() > 0) record_stack.removeFirst();
+            break;
+        case Journal_Clear:
+            record_stack.clear();
+            break;
+        }
+    }
+
+    // Nothing changes until the journal is known to be for the ...
+    // ... widget's text: by the header's hash if the last session ...
+    // ... closed it, else (a crash) by the edits the next undo or ...
+    // ... redo would apply.
+    bool journal_matches;
+    if (new_journal->Is_Clean()) journal_matches = new_journal->Text_Matches(Current_Text());
+    else {
+        journal_matches = true;
+        if (undo_records.count() > 0)
+            journal_matches = Journal_Edit_Fits(new_journal->Record(undo_records.top()), Select_Undo);
+        if (journal_matches and (redo_records.count() > 0))
+            journal_matches = Journal_Edit_Fits(new_journal->Record(redo_records.top()), Select_Redo);
+    }
+    if (not journal_matches) {
+        delete new_journal;
+        return false;
+    }
+
+    // Start from the widget's text, the journal supplies the edits
+    Undo_Stack_Clear();
+    Redo_Stack_Discard();
+    Branches.clear();
+    Keyframes_Clear();
+    History.Load(Current_Text());
+    History_Cursor = Save_Cursor_State();
+    History_Generation = Document_Generation;
+    History_Valid = true;
+    Compress_Buffer = -1;
+
+    // Serials and times as journaled, so History_Index_At and ...
+    // ... Undo_Order work across sessions, new serials follow them
+    quint64 last_serial = 0;
+    for (int stack_idx = 0; stack_idx < 2; stack_idx += 1) {
+        RingBuffer<int> &record_stack = (stack_idx == 0) ? undo_records : redo_records;
+        for (int edit_idx = 0; edit_idx < record_stack.count(); edit_idx += 1) {
+            QDataStream record_stream(new_journal->Record(record_stack.at(edit_idx)));
+            quint8 journal_op, journal_stack;
+            quint64 serial;
+            qint64 time;
+            record_stream >> journal_op >> journal_stack >> serial >> time;
+
+            // Placeholder until Read_Journal_Edit fills it in
+            Text_Edit journal_edit;
+            journal_edit.Position = 0;
+            journal_edit.Before = History_Cursor;
+            journal_edit.After = History_Cursor;
+            journal_edit.Journal_Record = record_stack.at(edit_idx);
+            journal_edit.Serial = serial;
+            journal_edit.Time = time;
+            ((stack_idx == 0) ? Undo_Stack : Redo_Stack).push(journal_edit);
+            last_serial = qMax(last_serial, serial);
+        }
+    }
+    Advance_Serial(last_serial);
+    Journal = new_journal;
+    Base_Serial = Next_Serial();
+
+    // Only the edits the next undo or redo would apply are read now
+    if (Undo_Stack.count() > 0) Read_Journal_Edit(Undo_Stack.top());
+    if (Redo_Stack.count() > 0) Read_Journal_Edit(Redo_Stack.top());
+
+    Recount_Bytes();
+    Enforce_Undo_Capacity(0, 0);
+    Compact_Journal();
+
+    return true;
+}
+
+// Edits not read yet are read now, the mapping goes away w/ the journal
+void
+UndoRedo::Close_Journal ( ) {
+    if (Journal == nullptr) return;
+
+    Materialize_Boundaries();
+    Read_Journal_Edits();
+
+    Journal->Mark_Clean(Current_Text());
+    delete Journal;
+    Journal = nullptr;
+}
+
+void
+UndoRedo::Read_Journal_Edits ( ) {
+    for (int edit_idx = 0; edit_idx < Undo_Stack.count(); edit_idx += 1)
+        if (Undo_Stack.at(edit_idx).Journal_Record >= 0) Read_Journal_Edit(Undo_Stack[edit_idx]);
+    for (int edit_idx = 0; edit_idx < Redo_Stack.count(); edit_idx += 1)
+        if (Redo_Stack.at(edit_idx).Journal_Record >= 0) Read_Journal_Edit(Redo_Stack[edit_idx]);
+    Recount_Bytes();
+}
+
+// Only between stack operations, a popped edit may still be ...
+// ... waiting to be read from the mapping the rewrite drops
+void
+UndoRedo::Compact_Journal ( ) {
+    if (Journal == nullptr) return;
+
+    int live_count = Undo_Stack.count() + Redo_Stack.count();
+    int journaled_count = Journal->Journaled_Count();
+    if (not (((live_count == 0) and (journaled_count > 0)) or
+             (journaled_count > ((Journal_Compact_Factor * live_count) + Journal_Compact_Minimum_Records))))
+        return;
+
+    Read_Journal_Edits();
+
+    QVector<QByteArray> records;
+    records.reserve(live_count);
+    for (int edit_idx = 0; edit_idx < Undo_Stack.count(); edit_idx += 1)
+        records.append(Journal_Record_Bytes(Journal_Push, Select_Undo, &Undo_Stack.at(edit_idx)));
+    for (int edit_idx = 0; edit_idx < Redo_Stack.count(); edit_idx += 1)
+        records.append(Journal_Record_Bytes(Journal_Push, Select_Redo, &Redo_Stack.at(edit_idx)));
+    Journal->Rewrite(records);
+}
+
+// Counts the boundary state as well as each recorded edit, ...
+// ... zero means no boundary has been captured yet.
 int
 UndoRedo::Undo_Stack_Count ( ) {
-    return Undo_Stack.count();
+    return Undo_Stack.count() + Boundary_Markers.count() + (History_Valid ? 1 : 0);
 }
 
 int
@@ -159,39 +1509,343 @@ UndoRedo::Redo_Stack_Count ( ) {
     return Redo_Stack.count();
 }
 
+qint64
+UndoRedo::History_Bytes ( ) {
+    return Undo_Bytes + Redo_Bytes + Branch_Bytes;
+}
+
+quint64
+UndoRedo::Next_Serial ( ) {
+    if (not (Serial_Source == nullptr)) {
+        *Serial_Source += 1;
+        return *Serial_Source;
+    }
+    Last_Serial += 1;
+    return Last_Serial;
+}
+
+// Serials handed out from now on are all above Serial
+void
+UndoRedo::Advance_Serial ( quint64 Serial ) {
+    if (not (Serial_Source == nullptr)) *Serial_Source = qMax(*Serial_Source, Serial);
+    else Last_Serial = qMax(Last_Serial, Serial);
+}
+
+void
+UndoRedo::Set_Serial_Source ( quint64 *New_Serial_Source ) {
+    Serial_Source = New_Serial_Source;
+}
+
+quint64
+UndoRedo::Undo_Order ( ) {
+    if (History_Valid and (not (Document_Generation == History_Generation))) return Changed_Serial;
+    if (not Boundary_Markers.isEmpty()) return Boundary_Markers.last().Serial;
+    if (Undo_Stack.count() > 0) return Undo_Stack.top().Serial;
+    return 0;
+}
+
 
 void
 UndoRedo::Push_Undo ( ) {
+#if defined(UNDOREDO_METRICS)
+    QElapsedTimer push_timer;
+    push_timer.start();
+#endif
+
     Deferred_Push_Undo = false;
+    Finish_Restore();
+
+    Redo_Stack_Clear();
+    if (not Mark_Boundary()) {
+        Push_State(Select_Undo);
+        Schedule_Compression();
+    }
 
-    while (Undo_Stack.count() >= Maximum_Undo_Stack_Count) Undo_Stack.removeFirst();
+    Do_State.truncate(0);
+
+#if defined(UNDOREDO_METRICS)
+    Count_Latency(Counters.Push_Latency, push_timer.nsecsElapsed());
+#endif
+}
 
+void
+UndoRedo::Typing_Boundary ( const QString &Typed_Text ) {
     Redo_Stack_Clear();
-    Push_State(Select_Undo);
+    if (Deferred_Push_Undo or (Undo_Stack_Count() == 0) or
+        // Selection about to be replaced
+        (Selected_Count() > 0)) {
+        this->Push_Undo();
+    }
+    else if ((Do_State.length() > 0) and
+             (not Is_Identifier_Or_Number(Do_State.at(Do_State.length() - 1))) and
+             // Start of identifier or number
+             Is_Identifier_Or_Number(Typed_Text.at(0))) {
+        this->Push_Undo();
+    }
+
+    Do_State += Typed_Text;
+}
 
-    Do_State = "";
+// Instantiated per built-in policy, see BoundaryPolicy::Builtin_Table
+template <typename Policy_Table>
+static void
+Append_Unit_Begins ( const QString &Inserted_Text, const Policy_Table &Boundary_Table, QVector<int> &Unit_Begins ) {
+    const ushort *text_data = Inserted_Text.utf16();
+    bool previous_identifier = true;
+    for (int ch_idx = 0; ch_idx < Inserted_Text.length(); ch_idx += 1) {
+        ushort ch = text_data[ch_idx];
+        bool identifier = ((ch < 256) ? Boundary_Table.Get().Is_Unit[ch]
+                                      : BoundaryPolicy::Is_Unit(Boundary_Table.Get(), QChar(ch)));
+        if (identifier and (not previous_identifier)) Unit_Begins.append(ch_idx);
+        previous_identifier = identifier;
+    }
+}
+
+QVector<int>
+UndoRedo::Insert_Unit_Begins ( const QString &Inserted_Text ) {
+    QVector<int> unit_begins;
+    unit_begins.append(0);
+
+    if (Boundary_Table == &BoundaryPolicy::C_Like_Table)
+        Append_Unit_Begins(Inserted_Text, BoundaryPolicy::Builtin_Table<BoundaryPolicy::C_Like_Table>(), unit_begins);
+    else if (Boundary_Table == &BoundaryPolicy::Prose_Table)
+        Append_Unit_Begins(Inserted_Text, BoundaryPolicy::Builtin_Table<BoundaryPolicy::Prose_Table>(), unit_begins);
+    else if (Boundary_Table == &BoundaryPolicy::Numeric_Table)
+        Append_Unit_Begins(Inserted_Text, BoundaryPolicy::Builtin_Table<BoundaryPolicy::Numeric_Table>(), unit_begins);
+    else Append_Unit_Begins(Inserted_Text, BoundaryPolicy::Custom_Table { Boundary_Table }, unit_begins);
+
+    int maximum_unit_count = qMax(1, Maximum_Undo_Count / 2);
+    if (unit_begins.count() > maximum_unit_count)
+        unit_begins.remove(1, unit_begins.count() - maximum_unit_count);
+
+    return unit_begins;
+}
+
+void
+UndoRedo::Push_Undo_Units ( ) {
+    Finish_Restore();
+    if (not History_Valid) {
+        Push_Undo();
+        return;
+    }
+
+    Deferred_Push_Undo = false;
+    Redo_Stack_Clear();
+
+    Text_Edit pending_edit = Pending_Edit();
+    if (not Is_Null_Edit(pending_edit)) {
+        QVector<int> unit_begins = Insert_Unit_Begins(History.Text(pending_edit.Inserted));
+        int inserted_length = PieceTable::Length(pending_edit.Inserted);
+
+        // Each unit is an edit of its own, only the first replaces ...
+        // ... what was removed (e.g. the selection pasted over)
+        Cursor_State unit_cursor = pending_edit.Before;
+        for (int unit_idx = 0; unit_idx < unit_begins.count(); unit_idx += 1) {
+            int unit_begin = unit_begins.at(unit_idx);
+            bool last_unit = (unit_idx == (unit_begins.count() - 1));
+            int unit_end = last_unit ? inserted_length : unit_begins.at(unit_idx + 1);
+
+            Text_Edit unit_edit;
+            unit_edit.Position = pending_edit.Position + unit_begin;
+            if (unit_idx == 0) unit_edit.Removed = pending_edit.Removed;
+            unit_edit.Inserted = PieceTable::Slice(pending_edit.Inserted, unit_begin, unit_end - unit_begin);
+            unit_edit.Before = unit_cursor;
+            if (last_unit) unit_edit.After = pending_edit.After;
+            else {
+                unit_edit.After.Select_Begin = pending_edit.Position + unit_end;
+                unit_edit.After.Select_End = unit_edit.After.Select_Begin;
+                unit_edit.After.Cursor_Position = unit_edit.After.Select_Begin;
+            }
+            unit_cursor = unit_edit.After;
+
+#if defined(UNDOREDO_METRICS)
+            Counters.Push_Count += 1;
+#endif
+            Push_Edit(Select_Undo, unit_edit);
+            History.Replace(unit_edit.Position, PieceTable::Length(unit_edit.Removed), unit_edit.Inserted);
+            Keyframe_Undo_Top();
+        }
+
+        History_Cursor = pending_edit.After;
+        History_Generation = Document_Generation;
+    }
+
+    Do_State.truncate(0);
+
+    Schedule_Compression();
 }
 
 void
 UndoRedo::Execute_Undo ( ) {
-    if (Undo_Stack.count() > 0) {
-        // Make sure we can get back to where we are
-        Push_State(Select_Redo);
-        Pop_State(Select_Undo);
-        Do_State = "";
+#if defined(UNDOREDO_METRICS)
+    QElapsedTimer undo_timer;
+    undo_timer.start();
+#endif
+
+    // Merged into one jump once the restore under way is done
+    if (Restore_Active) {
+        Queued_Steps -= 1;
+        return;
+    }
+
+    // The cursor is moving away from where the indicator marks
+    if (not (Focus_PlainTextEdit == nullptr)) Focus_PlainTextEdit->removeTextCursorIndicator();
+
+    if (History_Valid) {
+        // Make sure we can get back to where we are, ...
+        // ... if anything was pending that alone is undone
+        if (not Push_State(Select_Redo)) Pop_State(Select_Undo);
+        Do_State.truncate(0);
+
+#if defined(UNDOREDO_METRICS)
+        Counters.Undo_Count += 1;
+        Count_Latency(Counters.Undo_Redo_Latency, undo_timer.nsecsElapsed());
+#endif
     }
 }
 
 void
 UndoRedo::Execute_Redo ( ) {
+#if defined(UNDOREDO_METRICS)
+    QElapsedTimer redo_timer;
+    redo_timer.start();
+#endif
+
+    if (Restore_Active) {
+        Queued_Steps += 1;
+        return;
+    }
+
+    if (not (Focus_PlainTextEdit == nullptr)) Focus_PlainTextEdit->removeTextCursorIndicator();
+
+    // Typed but not yet pushed, redo no longer follows from the document, ...
+    // ... the change becomes an edit and redo is set aside, as in Go_To
+    if (Text_Pending()) {
+        Materialize_Boundaries();
+        quint64 pending_parent_serial = Undo_Top_Serial();
+        if (Push_State(Select_Undo)) {
+            Set_Aside_Redo(pending_parent_serial);
+            return;
+        }
+    }
+
     if (Redo_Stack.count() > 0) {
         // Make sure we can get back to where we are
         Push_State(Select_Undo);
         Pop_State(Select_Redo);
-        Do_State = "";
+        Do_State.truncate(0);
+
+#if defined(UNDOREDO_METRICS)
+        Counters.Redo_Count += 1;
+        Count_Latency(Counters.Undo_Redo_Latency, redo_timer.nsecsElapsed());
+#endif
+    }
+}
+
+int
+UndoRedo::History_Index ( ) {
+    if (not History_Valid) return 0;
+    // Markers found to change nothing are not edits
+    Materialize_Boundaries();
+    return Undo_Stack.count() + (Text_Pending() ? 1 : 0);
+}
+
+int
+UndoRedo::History_Length ( ) {
+    if (not History_Valid) return 0;
+    Materialize_Boundaries();
+    if (Text_Pending()) return Undo_Stack.count() + 1;
+    return Undo_Stack.count() + Redo_Stack.count();
+}
+
+bool
+UndoRedo::Go_To_History_Index ( int Index ) {
+#if defined(UNDOREDO_METRICS)
+    QElapsedTimer go_to_timer;
+    go_to_timer.start();
+#endif
+
+    Finish_Restore();
+    if ((not History_Valid) or (Index < 0) or (Index > History_Length())) return false;
+
+    if (not (Focus_PlainTextEdit == nullptr)) Focus_PlainTextEdit->removeTextCursorIndicator();
+
+    // Make sure we can get back to where we are
+    if (not (Document_Generation == History_Generation)) {
+        quint64 pending_parent_serial = Undo_Top_Serial();
+        if (Push_State(Select_Undo)) Set_Aside_Redo(pending_parent_serial);
+    }
+
+    int current_index = Undo_Stack.count();
+    if (Index < current_index) Pop_States(Select_Undo, current_index - Index);
+    else if (Index > current_index) Pop_States(Select_Redo, Index - current_index);
+    Do_State.truncate(0);
+
+#if defined(UNDOREDO_METRICS)
+    if (Index < current_index) Counters.Undo_Count += quint64(current_index - Index);
+    else Counters.Redo_Count += quint64(Index - current_index);
+    Count_Latency(Counters.Undo_Redo_Latency, go_to_timer.nsecsElapsed());
+#endif
+    return true;
+}
+
+bool
+UndoRedo::Undo_Steps ( int Steps ) {
+    return Go_To_History_Index(qMax(0, History_Index() - Steps));
+}
+
+bool
+UndoRedo::Redo_Steps ( int Steps ) {
+    return Go_To_History_Index(qMin(History_Length(), History_Index() + Steps));
+}
+
+int
+UndoRedo::History_Index_At ( qint64 Time ) {
+    // A pending change is newer than any edit, and not an edit yet
+    int history_length = History_Length();
+    int edit_count = Text_Pending() ? Undo_Stack.count() : history_length;
+
+    // Edit N leads to state N + 1, count the edits made by Time
+    int low_index = 0;
+    int high_index = edit_count;
+    while (low_index < high_index) {
+        int middle_index = low_index + ((high_index - low_index) / 2);
+        if (Path_Edit(middle_index).Time <= Time) low_index = middle_index + 1;
+        else high_index = middle_index;
     }
+    return low_index;
 }
 
+#if defined(UNDOREDO_METRICS)
+UndoRedo::History_Metrics
+UndoRedo::Metrics ( ) {
+    History_Metrics current_metrics = Counters;
+    current_metrics.Undo_Edit_Count = Undo_Stack.count() + Boundary_Markers.count();
+    current_metrics.Redo_Edit_Count = Redo_Stack.count();
+    current_metrics.Branch_Count = Branches.count();
+    current_metrics.Undo_Bytes = Undo_Bytes;
+    current_metrics.Redo_Bytes = Redo_Bytes;
+    current_metrics.Branch_Bytes = Branch_Bytes;
+    return current_metrics;
+}
+
+void
+UndoRedo::Reset_Metrics ( ) {
+    Counters = History_Metrics();
+}
+
+void
+UndoRedo::Set_Metrics_Interval ( int New_Metrics_Interval_Milliseconds ) {
+    if (New_Metrics_Interval_Milliseconds > 0) Metrics_Timer.start(New_Metrics_Interval_Milliseconds, this);
+    else Metrics_Timer.stop();
+}
+
+void
+UndoRedo::Metrics_Timeout ( ) {
+    emit Metrics_Report(Metrics());
+}
+#endif
+
 // This supports less aggressive undo/redo command compression.
 // Normally any adjacent insert operations are treated as a single ...
 // ... undoable/redoable operation. When inserts are being made in ...
@@ -213,8 +1867,18 @@ UndoRedo::Execute_Redo ( ) {
 
 void
 UndoRedo::Clear_No_Undo ( ) {
+    Finish_Restore();
+    Boundary_Markers.clear();
     Undo_Stack_Clear();
-    Redo_Stack_Clear();
+    Redo_Stack_Discard();
+    Branches.clear();
+    Branch_Bytes = 0;
+    Compact_Journal();
+    Keyframes_Clear();
+    History.Clear();
+    History_Valid = false;
+    // Whatever is being compressed belonged to the old buffers
+    Compress_Buffer = -1;
     if (not (Focus_LineEdit == nullptr)) Focus_LineEdit->clear();
     else if (not (Focus_PlainTextEdit == nullptr)) Focus_PlainTextEdit->clear();
 }
@@ -228,10 +1892,67 @@ UndoRedo::SetText_No_Undo ( QString New_Text ) {
 }
 
 bool
-UndoRedo::Is_Identifier_Or_Number ( QChar Test_Ch ) {
-    return (Test_Ch.isLetterOrNumber() or
-            (Test_Ch == "_") or  (Test_Ch == ".") or
-            (Test_Ch == Unicode_Thin_Space));
+UndoRedo::Load_File_No_Undo ( const QString &File_Path ) {
+    QFile load_file(File_Path);
+    if (not load_file.open(QIODevice::ReadOnly)) return false;
+    qint64 file_size = load_file.size();
+    if (file_size > Maximum_Load_File_Bytes) return false;
+    const uchar *file_data = nullptr;
+    if (file_size > 0) {
+        file_data = load_file.map(0, file_size);
+        if (file_data == nullptr) return false;
+    }
+
+    Clear_No_Undo();
+
+    // Never more characters than bytes, so the text is not reallocated
+    QString original_text;
+    original_text.reserve(int(file_size));
+
+    QTextCursor load_cursor;
+    if (not (Focus_PlainTextEdit == nullptr)) {
+        load_cursor = QTextCursor(Focus_PlainTextEdit->document());
+        // One change notification (and one layout) for the whole file
+        load_cursor.beginEditBlock();
+    }
+
+    // A sequence split between chunks is finished by the next one
+    QTextDecoder *text_decoder = QTextCodec::codecForName("UTF-8")->makeDecoder();
+    bool ended_in_return = false;
+    for (qint64 chunk_begin = 0; chunk_begin < file_size; chunk_begin += Load_File_Chunk_Bytes) {
+        int chunk_bytes = int(qMin(qint64(Load_File_Chunk_Bytes), file_size - chunk_begin));
+        QString chunk_text = text_decoder->toUnicode(reinterpret_cast<const char*>(file_data + chunk_begin),
+                                                     chunk_bytes);
+        Normalize_Line_Ends(chunk_text, ended_in_return);
+        if (not (Focus_PlainTextEdit == nullptr)) load_cursor.insertText(chunk_text);
+
+        int chunk_position = original_text.length();
+        original_text.append(chunk_text);
+        Plain_Text_Fixups(original_text, chunk_position);
+    }
+    delete text_decoder;
+    if (not (file_data == nullptr)) load_file.unmap(const_cast<uchar*>(file_data));
+
+    if (not (Focus_PlainTextEdit == nullptr)) load_cursor.endEditBlock();
+    else if (not (Focus_LineEdit == nullptr)) Focus_LineEdit->setText(original_text);
+
+    // The loaded text is the first boundary
+    History.Load(original_text);
+    History_Cursor = Save_Cursor_State();
+    History_Generation = Document_Generation;
+    History_Valid = true;
+    Do_State.truncate(0);
+    return true;
+}
+
+void
+UndoRedo::Set_Boundary_Policy ( BoundaryPolicy::Policy New_Boundary_Policy ) {
+    Boundary_Table = BoundaryPolicy::Policy_Table(New_Boundary_Policy);
+}
+
+void
+UndoRedo::Set_Boundary_Table ( const BoundaryPolicy::Table *New_Boundary_Table ) {
+    if (not (New_Boundary_Table == nullptr)) Boundary_Table = New_Boundary_Table;
 }
 
 bool
@@ -248,6 +1969,12 @@ UndoRedo::keyPressEvent_Handler ( QKeyEvent *event ) {
         already_handled_event = true;
         // Otherwise normal undo will trash text
     }
+    else if (Restore_Active or
+             ((not (Focus_PlainTextEdit == nullptr)) and Focus_PlainTextEdit->isReadOnly()) or
+             ((not (Focus_LineEdit == nullptr)) and Focus_LineEdit->isReadOnly())) {
+        // The read-only widget drops the keystroke (e.g. during an ...
+        // ... asynchronous restore), no boundary and redo stays
+    }
     else if ((event->matches(QKeySequence::Backspace)) or
              (event->matches(QKeySequence::Delete))) {
         this->Push_Undo();
@@ -277,22 +2004,7 @@ UndoRedo::keyPressEvent_Handler ( QKeyEvent *event ) {
 //        else if ((modifiers & Qt::AltModifier) == Qt::AltModifier) {}
 
         if (modifiers == Qt::NoModifier) {
-            if (event->text().length() > 0) {
-                Redo_Stack_Clear();
-                if (Deferred_Push_Undo or (Undo_Stack.count() == 0) or
-                    // Selection about to be replaced
-                    (Selected_Count() > 0)) {
-                    this->Push_Undo();
-                }
-                else if ((Do_State.length() > 0) and
-                         (not Is_Identifier_Or_Number(Do_State.at(Do_State.length() - 1))) and
-                         // Start of identifier or number
-                         Is_Identifier_Or_Number(event->text().at(0))) {
-                    this->Push_Undo();
-                }
-
-                Do_State += event->text();
-            }
+            if (event->text().length() > 0) Typing_Boundary(event->text());
         }
     }
 
@@ -19,8 +19,19 @@
 #define UNDOREDO_H
 
 #include <QObject>
-#include <QStack>
 #include <QKeyEvent>
+#include <QFutureWatcher>
+#include <QHash>
+#include <QTextCursor>
+#include <QBasicTimer>
+#if defined(UNDOREDO_METRICS)
+#include <QElapsedTimer>
+#endif
+
+#include "BoundaryPolicy.h"
+#include "PieceTable.h"
+#include "RingBuffer.h"
+#include "UndoJournal.h"
 
 class LineEdit;
 class PlainTextEdit;
@@ -29,6 +40,7 @@ class UndoRedo : public QObject {
     Q_OBJECT
 public:
     explicit UndoRedo ( QObject *parent = nullptr );
+    ~UndoRedo ( );
 
     void Set_Focus_Widget ( QWidget *New_Focus_Widget );
 
@@ -38,23 +50,119 @@ public:
     bool keyReleaseEvent_Handler ( QKeyEvent *event );
 
 private:
-    QWidget *Focus_Widget;
-    LineEdit *Focus_LineEdit;
-    PlainTextEdit *Focus_PlainTextEdit;
+    QWidget *Focus_Widget = nullptr;
+    LineEdit *Focus_LineEdit = nullptr;
+    PlainTextEdit *Focus_PlainTextEdit = nullptr;
+
+    // Bumped by the widget's change notifications, History_Generation ...
+    // ... is the value as of the last time History matched the widget, ...
+    // ... so "text unchanged" is a constant time test.
+    quint64 Document_Generation = 0;
+    quint64 History_Generation = 0;
+
+    // Set by the change notifications, see Undo_Order
+    quint64 Changed_Serial = 0;
+
+    // Document span changed since History_Generation, as the ...
+    // ... unchanged lengths at either end (PlainTextEdit only).
+    int Changed_Begin = 0;
+    int Changed_Tail = 0;
+
+private slots:
+    void Document_Changed ( );
+    void Document_Contents_Change ( int Position, int Chars_Removed, int Chars_Added );
 
-    struct Text_State {
-        QString Text;
+private:
+    struct Cursor_State {
         int Select_Begin;
         int Select_End;
         int Cursor_Position;
     };
 
-    Text_State Save_Text_State ( );
-    void Restore_Text_State ( Text_State New_Text_State );
+    // History records hold only the edit itself, not the document.
+    // Replacing Removed at Position with Inserted takes the "before" ...
+    // ... document to the "after" document, undo replaces Inserted ...
+    // ... with Removed, so memory and push cost scale with the size ...
+    // ... of the edit, not the size of the document.
+    // Both sides are pieces of History's buffers, no text is copied.
+    struct Text_Edit {
+        int Position;
+        PieceTable::Piece_List Removed;
+        PieceTable::Piece_List Inserted;
+        Cursor_State Before;
+        Cursor_State After;
+        // Not read from the journal yet when >= 0, see Read_Journal_Edit
+        int Journal_Record = -1;
+        // Identifies the state after this edit, see Undo_Branch
+        quint64 Serial = 0;
+        // When the state after this edit was reached, msecs since ...
+        // ... epoch, 0 if not known
+        qint64 Time = 0;
+    };
+
+    QString Current_Text ( );
+    QString Current_Text ( int Position, int Count );
+    Cursor_State Save_Cursor_State ( );
+    // Replaces only the changed span, the rest of the document ...
+    // ... (and its layout) is left alone.
+    void Restore_Text_State ( int Position, int Remove_Count, const QString &Insert_Text,
+                              Cursor_State New_Cursor_State );
+    // Puts the cursor back, w/ the view where the user was looking
+    void Restore_Cursor_View ( Cursor_State New_Cursor_State, int Horizontal_Value, int Vertical_Value );
+
+    // Restores of more than Asynchronous_Restore_Length characters ...
+    // ... are applied a chunk at a time over the event loop, at most ...
+    // ... Restore_Slice_Milliseconds a turn, the widget read only ...
+    // ... meanwhile (PlainTextEdit only). History is already as of ...
+    // ... the end. Undo/redo asked for meanwhile is merged into one ...
+    // ... jump once it is done, any other change finishes it first.
+#define Asynchronous_Restore_Length 1048576
+#define Restore_Chunk_Length 65536
+#define Restore_Slice_Milliseconds 8
+
+    bool Asynchronous_Restore = false;
+    bool Restore_Active = false;
+    // Timers are just ids, an idle history holds no timer object
+    QBasicTimer Restore_Timer;
+    QTextCursor Restore_Cursor;
+    int Restore_Position = 0;
+    int Restore_Remove_Count = 0;
+    QString Restore_Insert_Text;
+    int Restore_Insert_Offset = 0;
+    Cursor_State Restore_Cursor_State;
+    int Restore_Horizontal_Value = 0;
+    int Restore_Vertical_Value = 0;
+    bool Restore_Read_Only = false;
+    // Negative undoes, positive redoes
+    int Queued_Steps = 0;
+
+    // False once nothing is left to apply
+    bool Restore_Chunk ( );
+    // Applies the rest at once, w/o the queued steps
+    void Complete_Restore ( );
+    void Finish_Restore ( );
+    // The text differs from History, not just not restored yet
+    bool Text_Pending ( );
+
+protected:
+    // Restore_Timer and Metrics_Timer
+    void timerEvent ( QTimerEvent *Event ) override;
+
+private:
+    void Restore_Slice ( );
+
+private:
 
     int Selected_Count ( );
 
-#define Maximum_Undo_Stack_Count 100
+#define Default_Maximum_Undo_Stack_Count 100
+#define Do_State_Reserve_Length 64
+#define Default_Compress_Depth 10
+
+    // Oldest undo edits are evicted beyond either limit, ...
+    // ... a zero byte budget means count only.
+    int Maximum_Undo_Count = Default_Maximum_Undo_Stack_Count;
+    qint64 Maximum_Undo_Bytes = 0;
 
     // This supports less aggressive undo/redo command compression.
     // Normally any adjacent insert operations are treated as a single ...
@@ -63,35 +171,279 @@ private:
     // ... separately.
     enum Stack_Selector { Select_Undo, Select_Redo };
 
-    QStack<Text_State> Undo_Stack;
+    RingBuffer<Text_Edit> Undo_Stack;
     // The current state is here, between undo states and redo states
-    QStack<Text_State> Redo_Stack;
+    RingBuffer<Text_Edit> Redo_Stack;
+
+    // Approximate memory held by each stack's edits
+    qint64 Undo_Bytes = 0;
+    qint64 Redo_Bytes = 0;
+
+    // History buffers used only by edits deeper than Compress_Depth ...
+    // ... are compressed on a worker thread, one buffer at a time.
+    int Compress_Depth = Default_Compress_Depth;
+    // Created for the first compression, most histories never get one
+    QFutureWatcher<QByteArray> *Compress_Watcher = nullptr;
+    int Compress_Buffer = -1;
+
+    // Pieces per buffer of the redo edits and the Compress_Depth most ...
+    // ... recent undo edits, counted as edits enter and leave those, ...
+    // ... recounted (O(Compress_Depth + redo edits)) after a clear.
+    QVector<int> Hot_References;
+    bool Hot_References_Valid = false;
+
+    void Count_Hot_Edit ( const Text_Edit &Edit, int Delta );
+    void Recount_Hot_References ( );
+    bool Is_Buffer_Hot ( int Buffer );
+    void Schedule_Compression ( );
+
+private slots:
+    void Compression_Finished ( );
+
+private:
+    // Piece lists of evicted or discarded edits, emptied but w/ ...
+    // ... their capacity, new edits' pieces are built in them so ...
+    // ... steady typing and undo don't go to the heap for them.
+#define Maximum_Piece_List_Pool_Count 64
+
+    QVector<PieceTable::Piece_List> Piece_List_Pool;
+
+    PieceTable::Piece_List Take_Piece_List ( );
+    void Recycle_Piece_List ( PieceTable::Piece_List &Pieces );
+    void Recycle_Edit ( Text_Edit &Edit );
+
+    qint64 Edit_Bytes ( const Text_Edit &Edit );
+    void Push_Edit ( Stack_Selector Select_Stack, const Text_Edit &Edit );
+    Text_Edit Pop_Edit ( Stack_Selector Select_Stack );
+    void Enforce_Undo_Capacity ( int Reserve_Count, qint64 Reserve_Bytes );
+    void Recount_Bytes ( );
+
+    // Every change to either stack is journaled, replaying the ...
+    // ... operations rebuilds both stacks w/o decoding any edit.
+    enum Journal_Op { Journal_Push, Journal_Pop, Journal_Evict, Journal_Clear };
+    UndoJournal *Journal = nullptr;
+
+    QByteArray Journal_Record_Bytes ( Journal_Op Op, Stack_Selector Select_Stack, const Text_Edit *Edit = nullptr );
+    void Journal_Append ( Journal_Op Op, Stack_Selector Select_Stack, const Text_Edit *Edit = nullptr );
+    void Read_Journal_Edit ( Text_Edit &Edit );
+    void Read_Journal_Edits ( );
+    // Whether the document holds what undoing (or redoing) the ...
+    // ... edit in Record would replace, nothing is decoded into History
+    bool Journal_Edit_Fits ( const QByteArray &Record, Stack_Selector Select_Stack );
+
+    // Pops, evictions and clears leave records that replay to nothing, ...
+    // ... once they outweigh the live edits the journal is rewritten ...
+    // ... as just the pushes of the edits on the stacks (cleared ...
+    // ... stacks leave an empty journal).
+#define Journal_Compact_Minimum_Records 256
+#define Journal_Compact_Factor 2
+
+    void Compact_Journal ( );
+
+    // Redo edits are not discarded by a new edit, they are set aside ...
+    // ... as a branch hanging off the state they would be redone from ...
+    // ... (identified by the Serial of the undo edit below them, ...
+    // ... Base_Serial for the state below the whole undo stack).
+    // Branches hold only their own edits, what they share w/ the ...
+    // ... current path stays on the stacks. Branches are not journaled.
+    struct Undo_Branch {
+        quint64 Parent_Serial;
+        // Redo order, the last edit is redone first
+        QVector<Text_Edit> Edits;
+    };
+
+#define Maximum_Branch_Count 16
+
+    QVector<Undo_Branch> Branches;
+    qint64 Branch_Bytes = 0;
+    quint64 Last_Serial = 0;
+    quint64 Base_Serial = 0;
+    // A manager's counter shared by many histories, else Last_Serial
+    quint64 *Serial_Source = nullptr;
+
+    quint64 Next_Serial ( );
+    void Advance_Serial ( quint64 Serial );
+
+    quint64 Undo_Top_Serial ( );
+    void Set_Aside_Redo ( quint64 Parent_Serial );
+    void Drop_Branch ( int Branch );
+    void Drop_Branches_At ( quint64 Parent_Serial );
+    // Branches hanging off the discarded edits can't be reached ...
+    // ... anymore and go too, unless the edits were set aside as a ...
+    // ... branch themselves (switching to it reaches them again).
+    void Redo_Stack_Discard ( bool Keep_Branches = false );
+
+    // The text and cursor as of the last undo boundary (or undo/redo), ...
+    // ... the single document kept by the history. Everything typed ...
+    // ... since is the "pending" edit, History -> current text.
+    PieceTable History;
+    Cursor_State History_Cursor;
+    bool History_Valid = false;
+
+    Text_Edit Pending_Edit ( );
+    bool Is_Null_Edit ( const Text_Edit &Edit );
+    // Edit from History's [Changed_Begin, length - Changed_Tail) to ...
+    // ... Changed_Text, w/o what the change left as it was.
+    void Span_Edit ( Text_Edit &Edit, int Span_Begin, int Span_Tail, const QString &Changed_Text );
+
+    // The inserted side of a large replacement (e.g. a paste over ...
+    // ... a selection, a replace all) is line diffed against the ...
+    // ... removed side, lines it kept are pieces of History's text ...
+    // ... where they already are, only changed lines are copied.
+    // Beyond Maximum_Line_Diff_Distance changed lines, ...
+    // ... Maximum_Line_Diff_Lines lines on both sides, or ...
+    // ... Line_Diff_Budget_Milliseconds of diffing it is all copied, ...
+    // ... so a push never stalls typing on the diff.
+#define Line_Diff_Minimum_Length 4096
+#define Maximum_Line_Diff_Distance 512
+#define Maximum_Line_Diff_Lines 262144
+#define Line_Diff_Budget_Milliseconds 20
+
+    void Insert_Pieces ( const PieceTable::Piece_List &Removed, const QStringRef &Inserted_Text,
+                         PieceTable::Piece_List &Inserted_Pieces );
+
+    // Boundaries are only marked while typing, a marker keeps the ...
+    // ... changed span's text and the cursor, nothing is diffed, ...
+    // ... pushed or journaled. The markers are turned into undo edits ...
+    // ... (and History caught up) the first time the history itself ...
+    // ... is needed, e.g. by undo, or once there are too many. ...
+    // ... While a journal is open each one is turned at once, what ...
+    // ... the user typed must be in the file should the app crash.
+    // History_Generation/Changed_Begin/Changed_Tail are as of the ...
+    // ... last marker, History is as of the first.
+    struct Boundary_Marker {
+        int Changed_Begin;
+        int Changed_Tail;
+        QString Changed_Text;
+        bool Text_Changed;
+        Cursor_State Before;
+        Cursor_State After;
+        quint64 Serial;
+        qint64 Time;
+    };
+
+#define Maximum_Boundary_Marker_Count 32
+
+    QVector<Boundary_Marker> Boundary_Markers;
+
+    bool Mark_Boundary ( );
+    void Materialize_Boundaries ( );
+
+    // Select_Undo replaces Inserted w/ Removed, ...
+    // ... Select_Redo replaces Removed w/ Inserted.
+    // History (and the widget) must hold the opposite side of the edit.
+    void Apply_Edit ( const Text_Edit &Edit, Stack_Selector Direction );
 
     // If an Undo state is pushed (independent of undo execution) ...
     // ... Redo_Stack is cleared.
-    // Otherwise, for undo or redo execution, push the current state onto ...
-    // ... the opposite stack, pop the new state off same-named stack, and ...
-    // ... enforce that popped state.
-    void Push_State ( Stack_Selector Select_Stack );
+    // Otherwise, for undo or redo execution, push the pending edit onto ...
+    // ... the opposite stack, pop the edit off same-named stack, and ...
+    // ... apply it in that direction.
+    bool Push_State ( Stack_Selector Select_Stack );
     void Pop_State ( Stack_Selector Select_Stack );
+    // Pops Steps edits onto the opposite stack, History takes each ...
+    // ... in turn, the widget is restored once, over the span ...
+    // ... they changed between them.
+    void Pop_States ( Stack_Selector Select_Stack, int Steps );
+
+    // The undo stack bottom up, then the redo stack top down
+    const Text_Edit &Path_Edit ( int Index );
+    // State 0 is below the whole undo stack, state N follows edit N - 1
+    quint64 Path_Serial ( int Index );
+
+    // Every Keyframe_Edit_Count new edits, or once they add up to ...
+    // ... Keyframe_Change_Bytes, History's pieces are kept as a ...
+    // ... keyframe of the state (by Serial). Pop_States jumps History ...
+    // ... to the keyframe nearest its target and applies only the ...
+    // ... edits from there, so a long jump costs one keyframe plus ...
+    // ... at most an interval of edits. Keyframes share History's ...
+    // ... buffers, each costs a copy of the piece list.
+#define Default_Keyframe_Edit_Count 32
+#define Default_Keyframe_Change_Bytes 1048576
+
+    int Keyframe_Edit_Count = Default_Keyframe_Edit_Count;
+    qint64 Keyframe_Change_Bytes = Default_Keyframe_Change_Bytes;
+    QHash<quint64, PieceTable::Piece_List> Keyframes;
+    int Keyframe_Edits = 0;
+    qint64 Keyframe_Bytes = 0;
+
+    // After History took the new edit on top of the undo stack
+    void Keyframe_Undo_Top ( );
+    void Keyframes_Clear ( );
 
     bool Record_Move_Cursor_Undo = false;
 
+    // Where a unit begins is where typing would push: an identifier ...
+    // ... or number character after one that is not.
+    // At most half the undo capacity goes to one insert, the ...
+    // ... earliest units are merged, the last are undone one by one.
+    QVector<int> Insert_Unit_Begins ( const QString &Inserted_Text );
+
 public:
+    void Set_Maximum_Undo_Count ( int New_Maximum_Undo_Count );
+    void Set_Maximum_Undo_Bytes ( qint64 New_Maximum_Undo_Bytes );
+    // Zero turns compression of cold history off
+    void Set_Compress_Depth ( int New_Compress_Depth );
+    // Either zero means that limit is not used, both zero no keyframes
+    void Set_Keyframe_Interval ( int New_Keyframe_Edit_Count, qint64 New_Keyframe_Change_Bytes );
+
+    // The widget must already hold the document as it was when the ...
+    // ... journal was last written, its history is then restored. ...
+    // ... A journal for some other text is refused (false), the ...
+    // ... history and the file are left as they are.
+    bool Open_Journal ( const QString &Journal_Path );
+    void Close_Journal ( );
+
     void Undo_Stack_Clear ( );
+    // Sets the redo edits aside as a branch, see Switch_Branch
     void Redo_Stack_Clear ( );
 
+    // Branches are numbered oldest first, switching walks undo/redo ...
+    // ... to where the branch hangs off, then redoes it to its end, ...
+    // ... the path left behind becomes a branch in turn.
+    int Branch_Count ( );
+    int Branch_Edit_Count ( int Branch );
+    QString Branch_Preview ( int Branch );
+    bool Switch_Branch ( int Branch );
+
     int Undo_Stack_Count ( );
     int Redo_Stack_Count ( );
+    // What the capacity limits count, undo, redo and branch edits
+    qint64 History_Bytes ( );
+
+    // Serials come from Serial_Source from then on, so histories ...
+    // ... sharing it can tell which of them changed last
+    void Set_Serial_Source ( quint64 *New_Serial_Source );
+    // Serial of what the next undo would undo, 0 if nothing
+    quint64 Undo_Order ( );
 
     void Push_Undo ( );
     bool Deferred_Push_Undo = false;
 
+    // Pushes what was inserted since the last boundary as separate ...
+    // ... identifier/number units, as if it had been typed (e.g. ...
+    // ... for a paste), see Insert_Unit_Begins.
+    void Push_Undo_Units ( );
+
+    // Capacity is kept between units, see Do_State_Reserve_Length
     QString Do_State = "";
 
+    // The boundary typing Typed_Text pushes, Typed_Text is what ...
+    // ... one key typed.
+    void Typing_Boundary ( const QString &Typed_Text );
+
     // The strategy is to break the undo/redo "atoms" between identifiers ...
     // ... (e.g function/variable names), numbers, and keywords.
-    bool Is_Identifier_Or_Number ( QChar Test_Ch );
+    // What counts as such is up to the boundary policy, C_Like by default.
+    void Set_Boundary_Policy ( BoundaryPolicy::Policy New_Boundary_Policy );
+    void Set_Boundary_Table ( const BoundaryPolicy::Table *New_Boundary_Table );
+
+    bool Is_Identifier_Or_Number ( QChar Test_Ch ) {
+        return BoundaryPolicy::Is_Unit(*Boundary_Table, Test_Ch);
+    }
+
+private:
+    const BoundaryPolicy::Table *Boundary_Table = &BoundaryPolicy::C_Like_Table;
 
 public:
     // This supports less aggressive undo/redo command compression.
@@ -102,8 +454,87 @@ public:
     void Execute_Undo ( );
     void Execute_Redo ( );
 
+    // States along the undo/redo path are indexed oldest first, ...
+    // ... History_Index is the current one, History_Length the ...
+    // ... newest. A pending change counts as the newest state, going ...
+    // ... anywhere pushes it first (redo is set aside as a branch).
+    int History_Index ( );
+    int History_Length ( );
+    // One restore of the widget, whatever the number of steps
+    bool Go_To_History_Index ( int Index );
+    bool Undo_Steps ( int Steps );
+    bool Redo_Steps ( int Steps );
+    // Newest state reached at or before Time (msecs since epoch), ...
+    // ... edit times only grow along the path, so a binary search.
+    int History_Index_At ( qint64 Time );
+
     void Clear_No_Undo ( );
     void SetText_No_Undo ( QString New_Text );
+
+    // See Asynchronous_Restore_Length
+    void Set_Asynchronous_Restore ( bool New_Asynchronous_Restore );
+    bool Is_Restoring ( );
+
+signals:
+    // After an asynchronous restore (and any undo/redo merged into ...
+    // ... it) has been applied in full
+    void Restore_Finished ( );
+
+public:
+
+    // A (large) UTF-8 file becomes the text, w/o undo. The file is ...
+    // ... mapped and decoded a chunk at a time, each chunk goes into ...
+    // ... the document within one edit block, and the decoded text ...
+    // ... is History's original buffer as is, not a copy of the document.
+#define Load_File_Chunk_Bytes 4194304
+#define Maximum_Load_File_Bytes 536870912
+
+    bool Load_File_No_Undo ( const QString &File_Path );
+
+#if defined(UNDOREDO_METRICS)
+    // Built only w/ UNDOREDO_METRICS defined, otherwise none of this ...
+    // ... (nor its bookkeeping) exists.
+    // Latency histograms have power of two microsecond buckets, ...
+    // ... bucket 0 is under 1us, bucket N is [2^(N-1), 2^N) us, ...
+    // ... the last bucket is open ended.
+#define Metrics_Latency_Bucket_Count 24
+
+    struct History_Metrics {
+        // Boundaries that pushed an edit, and those the duplicate ...
+        // ... check in Push_State found nothing to push for
+        quint64 Push_Count = 0;
+        quint64 Push_Suppressed_Count = 0;
+        quint64 Undo_Count = 0;
+        quint64 Redo_Count = 0;
+        quint64 Evict_Count = 0;
+
+        // As of the snapshot
+        int Undo_Edit_Count = 0;
+        int Redo_Edit_Count = 0;
+        int Branch_Count = 0;
+        qint64 Undo_Bytes = 0;
+        qint64 Redo_Bytes = 0;
+        qint64 Branch_Bytes = 0;
+
+        quint64 Push_Latency[Metrics_Latency_Bucket_Count] = { };
+        quint64 Undo_Redo_Latency[Metrics_Latency_Bucket_Count] = { };
+        quint64 Restore_Latency[Metrics_Latency_Bucket_Count] = { };
+    };
+
+    History_Metrics Metrics ( );
+    void Reset_Metrics ( );
+    // Metrics_Report every interval, zero stops it
+    void Set_Metrics_Interval ( int New_Metrics_Interval_Milliseconds );
+
+signals:
+    void Metrics_Report ( const UndoRedo::History_Metrics &Metrics );
+
+private:
+    History_Metrics Counters;
+    QBasicTimer Metrics_Timer;
+
+    void Metrics_Timeout ( );
+#endif
 };
 
 
@@ -0,0 +1,87 @@
+/**************************************************************************
+**
+** Copyright (C) 2022 Ken Crossen, example expanded into useful application
+**
+** "Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are
+** met:
+**   * Redistributions of source code must retain the above copyright
+**     notice, this list of conditions and the following disclaimer.
+**   * Redistributions in binary form must reproduce the above copyright
+**     notice, this list of conditions and the following disclaimer in
+**     the documentation and/or other materials provided with the
+**     distribution.
+**   * Redistributions in source code or binary form may not be sold.
+**
+**************************************************************************/
+
+
+#include <QCoreApplication>
+#include <QPointer>
+
+#include "UndoRedoManager.h"
+
+UndoRedoManager::UndoRedoManager ( QObject *parent ) : QObject(parent) {
+}
+
+// Goes w/ the application (and a new one gets a new manager), ...
+// ... w/o one it would never go at all
+UndoRedoManager *
+UndoRedoManager::Shared ( ) {
+    Q_ASSERT_X(not (QCoreApplication::instance() == nullptr), "UndoRedoManager::Shared",
+               "needs the application object");
+    static QPointer<UndoRedoManager> shared_manager;
+    if (shared_manager.isNull()) shared_manager = new UndoRedoManager(QCoreApplication::instance());
+    return shared_manager;
+}
+
+UndoRedo *
+UndoRedoManager::History ( QWidget *Widget ) {
+    UndoRedo *widget_history = Histories.value(Widget, nullptr);
+    if (widget_history == nullptr) {
+        widget_history = new UndoRedo(this);
+        widget_history->Set_Serial_Source(&Last_Serial);
+        widget_history->Set_Focus_Widget(Widget);
+        Histories.insert(Widget, widget_history);
+        connect(Widget, SIGNAL(destroyed(QObject*)), this, SLOT(Widget_Destroyed(QObject*)));
+    }
+    return widget_history;
+}
+
+bool
+UndoRedoManager::Has_History ( QWidget *Widget ) {
+    return Histories.contains(Widget);
+}
+
+int
+UndoRedoManager::History_Count ( ) {
+    return Histories.count();
+}
+
+QWidget *
+UndoRedoManager::Undo_Widget ( ) {
+    QObject *undo_widget = nullptr;
+    quint64 undo_order = 0;
+    for (auto history_iter = Histories.constBegin(); history_iter != Histories.constEnd(); ++history_iter) {
+        quint64 widget_undo_order = history_iter.value()->Undo_Order();
+        if (widget_undo_order > undo_order) {
+            undo_order = widget_undo_order;
+            undo_widget = history_iter.key();
+        }
+    }
+    return qobject_cast<QWidget*>(undo_widget);
+}
+
+bool
+UndoRedoManager::Undo_Last ( ) {
+    QWidget *undo_widget = Undo_Widget();
+    if (undo_widget == nullptr) return false;
+
+    undo_widget->setFocus();
+    return QMetaObject::invokeMethod(undo_widget, "undo");
+}
+
+void
+UndoRedoManager::Widget_Destroyed ( QObject *Widget ) {
+    delete Histories.take(Widget);
+}
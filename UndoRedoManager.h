@@ -0,0 +1,65 @@
+/**************************************************************************
+**
+** Copyright (C) 2022 Ken Crossen, example expanded into useful application
+**
+** "Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are
+** met:
+**   * Redistributions of source code must retain the above copyright
+**     notice, this list of conditions and the following disclaimer.
+**   * Redistributions in binary form must reproduce the above copyright
+**     notice, this list of conditions and the following disclaimer in
+**     the documentation and/or other materials provided with the
+**     distribution.
+**   * Redistributions in source code or binary form may not be sold.
+**
+**************************************************************************/
+
+
+#ifndef UNDOREDOMANAGER_H
+#define UNDOREDOMANAGER_H
+
+#include <QObject>
+#include <QHash>
+#include <QWidget>
+
+#include "UndoRedo.h"
+
+// Serves the histories of any number of LineEdit/PlainTextEdit ...
+// ... widgets. A widget's history is created the first time it is ...
+// ... asked for (i.e. on its first edit), a field never edited ...
+// ... costs nothing, and is deleted w/ the widget.
+// Every history draws its edit serials from the manager, so edits ...
+// ... are ordered across widgets, see Undo_Last.
+// A history holds no timer or watcher object while idle, but keeps ...
+// ... its own piece buffers: its text and undo edits point into ...
+// ... them, buffers shared by many histories could only be freed ...
+// ... or compressed once every one of them let go.
+class UndoRedoManager : public QObject {
+    Q_OBJECT
+public:
+    explicit UndoRedoManager ( QObject *parent = nullptr );
+
+    // The application's manager, used by widgets not given another, ...
+    // ... only once the QCoreApplication exists
+    static UndoRedoManager *Shared ( );
+
+    UndoRedo *History ( QWidget *Widget );
+    bool Has_History ( QWidget *Widget );
+    int History_Count ( );
+
+    // The widget whose next undo is the most recent edit of all, ...
+    // ... nullptr if there is nothing to undo anywhere.
+    QWidget *Undo_Widget ( );
+    // Undoes that edit (through the widget's own undo slot)
+    bool Undo_Last ( );
+
+private:
+    QHash<QObject*, UndoRedo*> Histories;
+    quint64 Last_Serial = 0;
+
+private slots:
+    void Widget_Destroyed ( QObject *Widget );
+};
+
+#endif // UNDOREDOMANAGER_H